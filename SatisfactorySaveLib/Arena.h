@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace factorygame {
+
+    // Allocator over a std::pmr::memory_resource that, unlike std::pmr::polymorphic_allocator, moves along with
+    // the container: a string read into an arena stays there when it is move-assigned into a save object.
+    // Copies always go to the heap, so they can outlive the arena. Default constructed, it is a plain heap allocator.
+    template<typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        ArenaAllocator() noexcept : _resource(std::pmr::new_delete_resource()) {}
+        ArenaAllocator(std::pmr::memory_resource* resource) noexcept : _resource(resource ? resource : std::pmr::new_delete_resource()) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : _resource(other.resource()) {}
+
+        T* allocate(size_t count) {
+            return static_cast<T*>(_resource->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, size_t count) noexcept {
+            _resource->deallocate(ptr, count * sizeof(T), alignof(T));
+        }
+
+        ArenaAllocator select_on_container_copy_construction() const { return {}; }
+
+        std::pmr::memory_resource* resource() const noexcept { return _resource; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept {
+            return _resource == other.resource() || _resource->is_equal(*other.resource());
+        }
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const noexcept { return !(*this == other); }
+
+    private:
+        std::pmr::memory_resource* _resource;
+    };
+
+    using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    // Monotonic storage for a parsed save: nothing is freed one by one, the blocks are released together
+    // when the arena is destroyed. A monotonic resource is not thread safe, so every parse job takes its own.
+    class Arena {
+    public:
+        explicit Arena(size_t initialBlockSize = 64 * 1024) : _initialBlockSize(initialBlockSize) {}
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // thread safe, the returned resource must only be used by one thread at a time
+        std::pmr::memory_resource* newResource() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return &_resources.emplace_back(_initialBlockSize);
+        }
+
+    private:
+        const size_t _initialBlockSize;
+        std::mutex _mutex;
+        std::deque<std::pmr::monotonic_buffer_resource> _resources;
+    };
+
+}
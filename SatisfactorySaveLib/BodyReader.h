@@ -0,0 +1,205 @@
+#pragma once
+
+#include "ByteBuffer.h"
+#include "Endian.h"
+#include "Properties.h"
+#include "StringTable.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace factorygame {
+
+    // Cursor over a contiguous, little-endian buffer (e.g. the result of SaveFileLoader::decompressChunks).
+    // Every load is bounds-checked, the buffer must outlive the reader.
+    // A reader built from a ChunkSource pulls the body block by block instead, keeping only the unread tail.
+    class BodyReader {
+    public:
+        // Replaces chunk with the next block of the body, returns false at the end of the body
+        using ChunkSource = std::function<bool(ByteBuffer& chunk)>;
+
+        BodyReader(const uint8_t* data, int64_t size) : _begin(data), _pos(data), _end(data + size) {}
+        explicit BodyReader(const std::vector<uint8_t>& data) : BodyReader(data.data(), data.size()) {}
+        explicit BodyReader(const ByteBuffer& data) : BodyReader(data.data(), data.size()) {}
+        explicit BodyReader(ChunkSource source) : _source(std::move(source)), _streaming(true) {}
+
+        static constexpr auto MAX_STRING_LEN = 1024 * 1024;
+
+        // Strings and byte arrays are allocated from resource (e.g. from an Arena), null = heap
+        void setMemoryResource(std::pmr::memory_resource* resource) { _resource = resource; }
+        std::pmr::memory_resource* memoryResource() const { return _resource; }
+        // Table for readBasicType<InternedString>, must outlive the interned strings
+        void setStringTable(StringTable* strings) { _strings = strings; }
+        StringTable* stringTable() const { return _strings; }
+
+        int64_t position() const { return _bufferOffset + (_pos - _begin); }
+        // bytes available without pulling further chunks
+        int64_t remaining() const { return _end - _pos; }
+        const uint8_t* current() const { return _pos; }
+
+        template<typename T>
+        T readBasicType() {
+            static_assert(std::is_trivially_copyable_v<T>, "readBasicType needs a trivially copyable type");
+            _require(sizeof(T));
+            T value;
+            memcpy(&value, _pos, sizeof(T));
+            _pos += sizeof(T);
+            return littleEndian(value);
+        }
+
+        // Reads count consecutive scalars with one bounds check and copy, e.g. a fixed-layout record of floats
+        template<typename T>
+        void readBasicTypes(T* values, int64_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "readBasicTypes needs a trivially copyable type");
+            const int64_t size = count * static_cast<int64_t>(sizeof(T));
+            _require(size);
+            memcpy(values, _pos, size);
+            _pos += size;
+            littleEndianInPlace<T>(values, count);
+        }
+
+        template<>
+        String readBasicType() {
+            String value{ 0, ArenaString(_resource) };
+            const int32_t sizeTmp = readBasicType<int32_t>();
+            value.utf16 = sizeTmp < 0;
+            const int32_t size = std::abs(sizeTmp);
+            value.size = size;
+            if (size > MAX_STRING_LEN) {
+                throw std::runtime_error("String too large");
+            }
+            if (value.utf16) {
+                _require(2 * static_cast<int64_t>(size));
+                appendUtf16AsUtf8(_pos, utf16Strnlen(_pos, size), value.str);
+                _pos += 2 * static_cast<int64_t>(size);
+                return value;
+            }
+            _require(size);
+            const char* str = reinterpret_cast<const char*>(_pos);
+            value.str.assign(str, strnlen(str, size));
+            _pos += size;
+            return value;
+        }
+
+        // Zero-copy counterpart of readBasicType<String>, the view points into the reader's buffer.
+        // Streaming readers move their data around, so they only support the owning types.
+        template<>
+        StringView readBasicType() {
+            if (_streaming) {
+                throw std::runtime_error("String views need a contiguous save body");
+            }
+            StringView value;
+            const int32_t sizeTmp = readBasicType<int32_t>();
+            value.utf16 = sizeTmp < 0;
+            value.size = std::abs(sizeTmp);
+            if (value.size > MAX_STRING_LEN) {
+                throw std::runtime_error("String too large");
+            }
+            const int64_t byteSize = value.utf16 ? 2 * static_cast<int64_t>(value.size) : value.size;
+            _require(byteSize);
+            const char* str = reinterpret_cast<const char*>(_pos);
+            int64_t length = 0;
+            if (value.utf16) {
+                while (length + 1 < byteSize && (str[length] || str[length + 1])) {
+                    length += 2;
+                }
+            } else {
+                length = strnlen(str, byteSize);
+            }
+            value.str = std::string_view(str, length);
+            _pos += byteSize;
+            return value;
+        }
+
+        // same encoding as String, looked up in the string table without allocating for strings already seen
+        template<>
+        InternedString readBasicType() {
+            if (!_strings) {
+                throw std::runtime_error("No string table for interned strings");
+            }
+            const int32_t sizeTmp = readBasicType<int32_t>();
+            const int32_t size = std::abs(sizeTmp);
+            if (size > MAX_STRING_LEN) {
+                throw std::runtime_error("String too large");
+            }
+            if (sizeTmp < 0) {
+                // rare enough to decode before the lookup
+                thread_local ArenaString utf8;
+                utf8.clear();
+                _require(2 * static_cast<int64_t>(size));
+                appendUtf16AsUtf8(_pos, utf16Strnlen(_pos, size), utf8);
+                _pos += 2 * static_cast<int64_t>(size);
+                return _strings->intern(utf8, size, true);
+            }
+            _require(size);
+            const char* str = reinterpret_cast<const char*>(_pos);
+            _pos += size;
+            return _strings->intern(std::string_view(str, strnlen(str, size)), size);
+        }
+
+        void readBytes(uint8_t* dst, int64_t size) {
+            _require(size);
+            memcpy(dst, _pos, size);
+            _pos += size;
+        }
+
+        void skip(int64_t size) {
+            _require(size);
+            _pos += size;
+        }
+
+    private:
+        const uint8_t* _begin = nullptr;
+        const uint8_t* _pos = nullptr;
+        const uint8_t* _end = nullptr;
+
+        std::pmr::memory_resource* _resource = nullptr;
+        StringTable* _strings = nullptr;
+
+        ChunkSource _source;
+        bool _streaming = false;
+        ByteBuffer _buffer;
+        ByteBuffer _chunk;
+        int64_t _bufferOffset = 0;
+
+        void _require(int64_t size) {
+            if (size < 0 || size > _end - _pos) {
+                _refill(size);
+            }
+        }
+
+        void _refill(int64_t size) {
+            if (size < 0 || !_source) {
+                throw std::runtime_error("Unexpected end of save body");
+            }
+            // keep the unread tail, append blocks until the request fits
+            const int64_t consumed = _pos - _begin;
+            const int64_t unread = _end - _pos;
+            if (consumed > 0) {
+                memmove(_buffer.data(), _buffer.data() + consumed, unread);
+                _buffer.resize(unread);
+                _bufferOffset += consumed;
+            }
+            while (static_cast<int64_t>(_buffer.size()) < size) {
+                if (!_source(_chunk)) {
+                    _source = nullptr;
+                    break;
+                }
+                _buffer.insert(_buffer.end(), _chunk.begin(), _chunk.end());
+            }
+            _begin = _pos = _buffer.data();
+            _end = _begin + _buffer.size();
+            if (size > _end - _pos) {
+                throw std::runtime_error("Unexpected end of save body");
+            }
+        }
+    };
+
+}
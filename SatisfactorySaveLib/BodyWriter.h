@@ -0,0 +1,124 @@
+#pragma once
+
+#include "ByteBuffer.h"
+#include "Endian.h"
+#include "Properties.h"
+#include "StringTable.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace factorygame {
+
+    // Counterpart of BodyReader: writes little-endian values into a preallocated, bounds-checked range
+    class BodyWriter {
+    public:
+        BodyWriter(uint8_t* data, int64_t size) : _begin(data), _pos(data), _end(data + size) {}
+
+        int64_t position() const { return _pos - _begin; }
+        int64_t remaining() const { return _end - _pos; }
+
+        template<typename T>
+        void writeBasicType(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "writeBasicType needs a trivially copyable type");
+            _require(sizeof(T));
+            const T littleEndianValue = littleEndian(value);
+            memcpy(_pos, &littleEndianValue, sizeof(T));
+            _pos += sizeof(T);
+        }
+
+        template<typename T>
+        void writeBasicTypes(const T* values, int64_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "writeBasicTypes needs a trivially copyable type");
+            const int64_t size = count * static_cast<int64_t>(sizeof(T));
+            _require(size);
+            memcpy(_pos, values, size);
+            littleEndianInPlace<T>(_pos, count);
+            _pos += size;
+        }
+
+        template<>
+        void writeBasicType(const String& str) {
+            if (str.utf16) {
+                const int64_t units = utf16Length(str.str) + 1;
+                writeBasicType(static_cast<int32_t>(-units));
+                _require(2 * units);
+                writeUtf8AsUtf16(str.str, _pos);
+                _pos[2 * units - 2] = _pos[2 * units - 1] = 0;
+                _pos += 2 * units;
+                return;
+            }
+            if (str.str.empty()) {
+                writeBasicType(Int{ 0 });
+                return;
+            }
+            const int32_t size = static_cast<int32_t>(str.str.size() + 1);
+            writeBasicType(size);
+            _require(size);
+            memcpy(_pos, str.str.data(), str.str.size());
+            _pos[str.str.size()] = 0;
+            _pos += size;
+        }
+
+        template<>
+        void writeBasicType(const StringView& str) {
+            if (str.utf16) {
+                const int64_t units = str.str.size() / 2 + 1;
+                writeBasicType(static_cast<int32_t>(-units));
+                _require(2 * units);
+                memcpy(_pos, str.str.data(), str.str.size());
+                _pos[str.str.size()] = _pos[str.str.size() + 1] = 0;
+                _pos += 2 * units;
+                return;
+            }
+            if (str.str.empty()) {
+                writeBasicType(Int{ 0 });
+                return;
+            }
+            const int32_t size = static_cast<int32_t>(str.str.size() + 1);
+            writeBasicType(size);
+            _require(size);
+            memcpy(_pos, str.str.data(), str.str.size());
+            _pos[str.str.size()] = 0;
+            _pos += size;
+        }
+
+        template<>
+        void writeBasicType(const InternedString& str) {
+            writeBasicType(str.value());
+        }
+
+        void writeBytes(const uint8_t* src, int64_t size) {
+            _require(size);
+            if (size) {
+                memcpy(_pos, src, size);
+            }
+            _pos += size;
+        }
+
+    private:
+        uint8_t* _begin;
+        uint8_t* _pos;
+        uint8_t* _end;
+
+        void _require(int64_t size) const {
+            if (size < 0 || size > _end - _pos) {
+                throw std::runtime_error("Save body write out of bounds");
+            }
+        }
+    };
+
+    // Writes a value with a write(BodyWriter&) member to a stream, through a reusable per-thread buffer
+    template<typename T>
+    void writeToStream(const T& value, std::ostream& stream) {
+        thread_local ByteBuffer buffer;
+        buffer.resize(value.serializedSize());
+        BodyWriter writer(buffer.data(), buffer.size());
+        value.write(writer);
+        stream.write((const char*)buffer.data(), buffer.size());
+    }
+
+}
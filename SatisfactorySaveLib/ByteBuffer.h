@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace factorygame {
+
+    // Allocator that default-initializes on resize, so growing a byte buffer doesn't zero-fill it
+    template<typename T>
+    struct DefaultInitAllocator : std::allocator<T> {
+        template<typename U>
+        struct rebind {
+            using other = DefaultInitAllocator<U>;
+        };
+
+        DefaultInitAllocator() = default;
+        template<typename U>
+        DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+        template<typename U>
+        void construct(U* ptr) noexcept {
+            ::new (static_cast<void*>(ptr)) U;
+        }
+
+        template<typename U, typename... Args>
+        void construct(U* ptr, Args&&... args) {
+            ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+        }
+    };
+
+    // Byte vector for buffers that are overwritten right after resize (inflate targets, body buffers)
+    using ByteBuffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+}
@@ -1,8 +1,14 @@
 #include "Compressor.h"
 
 #include "zlib.h"
+#ifdef SATISFACTORY_WITH_LIBDEFLATE
+#include "libdeflate.h"
+#endif
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 inline void check_zlib_err(int err) {
@@ -12,88 +18,380 @@ inline void check_zlib_err(int err) {
     throw std::runtime_error(std::string("zlib error: ") + std::to_string(err));
 }
 
+// deflate/inflate report Z_BUF_ERROR when they can't progress, that's not fatal for the streaming loops
+inline void check_zlib_stream_err(int err) {
+    if (err == Z_STREAM_END || err == Z_BUF_ERROR) {
+        return;
+    }
+    if (err == Z_NEED_DICT) {
+        err = Z_DATA_ERROR;
+    }
+    check_zlib_err(err);
+}
+
+// zlib initializes everything it reads, no need to zero its ~256 KB deflate state
 static void* myalloc(void* q, unsigned int n, unsigned int  m) {
-    //std::cout << "myalloc " << n << " " << m << std::endl;
     (void)q;
-    return calloc(n, m);
+    return malloc((size_t)n * m);
 }
 
 static void myfree(void* q, void* p) {
-    //std::cout << "myfree" << std::endl;
     (void)q;
     free(p);
 }
 
-std::vector<uint8_t> Compressor::compress(const std::vector<uint8_t>& data) {
-    return Compressor::compress(data.data(), data.size());
+static constexpr size_t streamBufferSize = 64 * 1024;
+
+class Compressor::ZlibBackend : public CompressionBackend {
+public:
+    ~ZlibBackend() override {
+        if (deflateInitialized) {
+            deflateEnd(&deflateStream);
+        }
+        if (inflateInitialized) {
+            inflateEnd(&inflateStream);
+        }
+    }
+
+    std::vector<uint8_t> compressBlock(const uint8_t* data, int64_t size, const CompressionProfile& profile) override {
+        z_stream& c_stream = beginDeflate(profile);
+        std::vector<uint8_t> result;
+        result.resize(deflateBound(&c_stream, (uLong)size));
+
+        c_stream.next_in = (z_const unsigned char*)data;
+        c_stream.avail_in = (uInt)size;
+        c_stream.next_out = result.data();
+        c_stream.avail_out = (uInt)result.size();
+
+        // the output is deflateBound sized, a single Z_FINISH call completes the stream
+        int err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            check_zlib_err(err == Z_OK ? Z_BUF_ERROR : err);
+        }
+        result.resize(c_stream.total_out);
+        return result;
+    }
+
+    int64_t decompressBlock(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize) override {
+        z_stream& stream = beginInflate();
+        int err;
+
+        stream.next_in = (z_const unsigned char*)data;
+        stream.avail_in = (uInt)size;
+        stream.next_out = output;
+        stream.avail_out = (uInt)outputSize;
+
+        while (static_cast<int64_t>(stream.total_out) < outputSize && static_cast<int64_t>(stream.total_in) < size) {
+            err = inflate(&stream, Z_NO_FLUSH);
+            if (err == Z_STREAM_END) break;
+            check_zlib_err(err);
+        }
+
+        return static_cast<int64_t>(stream.total_out);
+    }
+
+    void compressStream(std::istream& input, std::ostream& output, int64_t targetSizeHint, const CompressionProfile& profile) {
+        z_stream& c_stream = beginDeflate(profile);
+        ensureStreamBuffers();
+        int err;
+
+        int64_t remaining = targetSizeHint;
+        int flush = Z_NO_FLUSH;
+        do {
+            const int64_t toRead = remaining < 0 ? (int64_t)inBuffer.size() : std::min<int64_t>(inBuffer.size(), remaining);
+            input.read((char*)inBuffer.data(), toRead);
+            const int64_t readSize = input.gcount();
+            if (input.bad()) {
+                throw std::runtime_error("Couldn't read uncompressed data");
+            }
+            if (remaining >= 0) {
+                remaining -= readSize;
+            }
+            flush = (readSize < toRead || remaining == 0) ? Z_FINISH : Z_NO_FLUSH;
+
+            c_stream.next_in = inBuffer.data();
+            c_stream.avail_in = (uInt)readSize;
+            do {
+                c_stream.next_out = outBuffer.data();
+                c_stream.avail_out = (uInt)outBuffer.size();
+                err = deflate(&c_stream, flush);
+                check_zlib_stream_err(err);
+                output.write((const char*)outBuffer.data(), outBuffer.size() - c_stream.avail_out);
+                if (!output) {
+                    throw std::runtime_error("Couldn't write compressed data");
+                }
+            } while (c_stream.avail_out == 0);
+        } while (flush != Z_FINISH);
+    }
+
+    void decompressStream(std::istream& input, std::ostream& output) {
+        z_stream& stream = beginInflate();
+        ensureStreamBuffers();
+        int err;
+
+        do {
+            input.read((char*)inBuffer.data(), inBuffer.size());
+            const int64_t readSize = input.gcount();
+            if (readSize == 0) {
+                throw std::runtime_error("Unexpected end of compressed data");
+            }
+
+            stream.next_in = inBuffer.data();
+            stream.avail_in = (uInt)readSize;
+            do {
+                stream.next_out = outBuffer.data();
+                stream.avail_out = (uInt)outBuffer.size();
+                err = inflate(&stream, Z_NO_FLUSH);
+                check_zlib_stream_err(err);
+                output.write((const char*)outBuffer.data(), outBuffer.size() - stream.avail_out);
+                if (!output) {
+                    throw std::runtime_error("Couldn't write decompressed data");
+                }
+            } while (stream.avail_out == 0 && err != Z_STREAM_END);
+        } while (err != Z_STREAM_END);
+
+        // give back what was read past the end of the zlib stream
+        if (stream.avail_in > 0) {
+            input.clear();
+            input.seekg(-(std::streamoff)stream.avail_in, std::ios::cur);
+        }
+    }
+
+private:
+    z_stream deflateStream{};
+    z_stream inflateStream{};
+    bool deflateInitialized = false;
+    bool inflateInitialized = false;
+    CompressionProfile deflateProfile;
+
+    std::vector<uint8_t> inBuffer;
+    std::vector<uint8_t> outBuffer;
+
+    // Streams are reset at the start of every use, so one failed call doesn't poison the next
+    // A profile change re-initializes the stream, memLevel can't be changed by deflateParams
+    z_stream& beginDeflate(const CompressionProfile& profile) {
+        if (deflateInitialized && profile == deflateProfile) {
+            check_zlib_err(deflateReset(&deflateStream));
+            return deflateStream;
+        }
+        if (deflateInitialized) {
+            deflateEnd(&deflateStream);
+            deflateInitialized = false;
+        }
+        deflateStream.zalloc = myalloc;
+        deflateStream.zfree = myfree;
+        deflateStream.opaque = (voidpf)0;
+        const int level = profile.store ? Z_NO_COMPRESSION : profile.level;
+        check_zlib_err(deflateInit2(&deflateStream, level, Z_DEFLATED, MAX_WBITS, profile.memLevel, zlibStrategy(profile.strategy)));
+        deflateInitialized = true;
+        deflateProfile = profile;
+        return deflateStream;
+    }
+
+    static int zlibStrategy(CompressionStrategy strategy) {
+        switch (strategy) {
+        case CompressionStrategy::Default: return Z_DEFAULT_STRATEGY;
+        case CompressionStrategy::Filtered: return Z_FILTERED;
+        case CompressionStrategy::HuffmanOnly: return Z_HUFFMAN_ONLY;
+        case CompressionStrategy::Rle: return Z_RLE;
+        case CompressionStrategy::Fixed: return Z_FIXED;
+        }
+        return Z_DEFAULT_STRATEGY;
+    }
+
+    z_stream& beginInflate() {
+        if (inflateInitialized) {
+            check_zlib_err(inflateReset(&inflateStream));
+            return inflateStream;
+        }
+        inflateStream.zalloc = myalloc;
+        inflateStream.zfree = myfree;
+        inflateStream.opaque = (voidpf)0;
+        inflateStream.next_in = Z_NULL;
+        inflateStream.avail_in = 0;
+        check_zlib_err(inflateInit(&inflateStream));
+        inflateInitialized = true;
+        return inflateStream;
+    }
+
+    void ensureStreamBuffers() {
+        inBuffer.resize(streamBufferSize);
+        outBuffer.resize(streamBufferSize);
+    }
+};
+
+#ifdef SATISFACTORY_WITH_LIBDEFLATE
+
+// One-shot whole-buffer API, chunk sizes are always known up front
+class LibdeflateBackend : public CompressionBackend {
+public:
+    LibdeflateBackend() : _compressor(libdeflate_alloc_compressor(_compressorLevel)), _decompressor(libdeflate_alloc_decompressor()) {
+        if (!_compressor || !_decompressor) {
+            libdeflate_free_compressor(_compressor);
+            libdeflate_free_decompressor(_decompressor);
+            throw std::bad_alloc();
+        }
+    }
+
+    ~LibdeflateBackend() override {
+        libdeflate_free_compressor(_compressor);
+        libdeflate_free_decompressor(_decompressor);
+    }
+
+    std::vector<uint8_t> compressBlock(const uint8_t* data, int64_t size, const CompressionProfile& profile) override {
+        const int level = profile.store ? 0 : (profile.level < 0 ? 6 : profile.level);
+        if (level != _compressorLevel) {
+            auto compressor = libdeflate_alloc_compressor(level);
+            if (!compressor) {
+                throw std::runtime_error("Invalid libdeflate compression level: " + std::to_string(level));
+            }
+            libdeflate_free_compressor(_compressor);
+            _compressor = compressor;
+            _compressorLevel = level;
+        }
+        std::vector<uint8_t> result;
+        result.resize(libdeflate_zlib_compress_bound(_compressor, size));
+        const size_t compressedSize = libdeflate_zlib_compress(_compressor, data, size, result.data(), result.size());
+        if (compressedSize == 0) {
+            throw std::runtime_error("libdeflate compression failed");
+        }
+        result.resize(compressedSize);
+        return result;
+    }
+
+    int64_t decompressBlock(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize) override {
+        size_t written = 0;
+        const auto err = libdeflate_zlib_decompress(_decompressor, data, size, output, outputSize, &written);
+        if (err != LIBDEFLATE_SUCCESS) {
+            throw std::runtime_error(std::string("libdeflate error: ") + std::to_string((int)err));
+        }
+        return written;
+    }
+
+private:
+    int _compressorLevel = 6;
+    libdeflate_compressor* _compressor;
+    libdeflate_decompressor* _decompressor;
+};
+
+#endif
+
+static std::atomic<CompressionBackendType> g_defaultBackend{ CompressionBackendType::Zlib };
+
+bool Compressor::isAvailable(CompressionBackendType backend) {
+    switch (backend) {
+    case CompressionBackendType::Zlib:
+        return true;
+    case CompressionBackendType::Libdeflate:
+#ifdef SATISFACTORY_WITH_LIBDEFLATE
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+std::string Compressor::backendName(CompressionBackendType backend) {
+    switch (backend) {
+    case CompressionBackendType::Zlib:
+#ifdef ZLIBNG_VERSION
+        return std::string("zlib-ng ") + ZLIBNG_VERSION;
+#else
+        return std::string("zlib ") + zlibVersion();
+#endif
+    case CompressionBackendType::Libdeflate:
+#ifdef SATISFACTORY_WITH_LIBDEFLATE
+        return std::string("libdeflate ") + LIBDEFLATE_VERSION_STRING;
+#else
+        return "libdeflate (not compiled in)";
+#endif
+    }
+    return "unknown";
 }
 
-std::vector<uint8_t> Compressor::compress(const uint8_t* data, int64_t size) {
-    std::vector<uint8_t> result;
-    result.resize(size + 64);
-    z_stream c_stream; /* compression stream */
-    int err;
-    auto len = size;
+void Compressor::setDefaultBackend(CompressionBackendType backend) {
+    if (!isAvailable(backend)) {
+        throw std::runtime_error("Compression backend not available: " + backendName(backend));
+    }
+    g_defaultBackend = backend;
+}
 
-    c_stream.zalloc = myalloc;
-    c_stream.zfree = myfree;
-    c_stream.opaque = (voidpf)0;
+CompressionBackendType Compressor::defaultBackend() {
+    return g_defaultBackend;
+}
 
-    //return (ZLibReturnCode)deflateInit2_64(ref strm, (int)level, (int)ZLibCompressionMethod.Deflated, windowBits, (int)ZLibMemLevel.Default, (int)ZLibCompressionStrategy.Default, ZLibVersion, Marshal.SizeOf(typeof(z_streamp)));
-    //err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
-    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
-    check_zlib_err(err);
+Compressor::Compressor(CompressionBackendType backend) : _backendType(backend), _zlib(std::make_unique<ZlibBackend>()) {
+    switch (backend) {
+    case CompressionBackendType::Zlib:
+        break;
+    case CompressionBackendType::Libdeflate:
+#ifdef SATISFACTORY_WITH_LIBDEFLATE
+        _blockBackend = std::make_unique<LibdeflateBackend>();
+        break;
+#else
+        throw std::runtime_error("Compression backend not available: " + backendName(backend));
+#endif
+    }
+}
 
-    c_stream.avail_in = len;
-    c_stream.next_in = (z_const unsigned char*)data;
-    c_stream.next_out = result.data();
-    c_stream.avail_out = result.size();
+Compressor::~Compressor() = default;
 
-    while (c_stream.total_in != len && c_stream.total_out < result.size()) {
-        err = deflate(&c_stream, Z_NO_FLUSH);
-        check_zlib_err(err);
+Compressor& Compressor::threadLocal() {
+    static thread_local std::unique_ptr<Compressor> compressor;
+    const auto backend = defaultBackend();
+    if (!compressor || compressor->backend() != backend) {
+        compressor = std::make_unique<Compressor>(backend);
     }
-    /* Finish the stream, still forcing small buffers: */
-    for (;;) {
-        err = deflate(&c_stream, Z_FINISH);
-        if (err == Z_STREAM_END) break;
-        check_zlib_err(err);
+    return *compressor;
+}
+
+CompressionBackend& Compressor::_block() {
+    if (_blockBackend) {
+        return *_blockBackend;
     }
+    return *_zlib;
+}
 
-    err = deflateEnd(&c_stream);
-    check_zlib_err(err);
-    result.resize(c_stream.total_out);
-	return result;
+std::vector<uint8_t> Compressor::compressBlock(const uint8_t* data, int64_t size, const CompressionProfile& profile) {
+    return _block().compressBlock(data, size, profile);
+}
+
+int64_t Compressor::decompressBlock(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize) {
+    return _block().decompressBlock(data, size, output, outputSize);
+}
+
+void Compressor::compressStream(std::istream& input, std::ostream& output, int64_t targetSizeHint, const CompressionProfile& profile) {
+    _zlib->compressStream(input, output, targetSizeHint, profile);
+}
+
+void Compressor::decompressStream(std::istream& input, std::ostream& output) {
+    _zlib->decompressStream(input, output);
+}
+
+std::vector<uint8_t> Compressor::compress(const std::vector<uint8_t>& data, const CompressionProfile& profile) {
+    return Compressor::compress(data.data(), data.size(), profile);
 }
 
+std::vector<uint8_t> Compressor::compress(const uint8_t* data, int64_t size, const CompressionProfile& profile) {
+    return threadLocal().compressBlock(data, size, profile);
+}
 
 std::vector<uint8_t> Compressor::decompress(const std::vector<uint8_t>& data, int64_t targetSizeHint) {
 	std::vector<uint8_t> result;
 	result.resize(targetSizeHint);
-    int err;
-	z_stream stream;
-    stream.zalloc = myalloc;
-    stream.zfree = myfree;
-    stream.opaque = (voidpf)0;
-
-    stream.next_in = (uint8_t*)data.data();
-    stream.avail_in = data.size();
-    stream.next_out = result.data();
-    stream.avail_out = result.size();
-
-    err = inflateInit(&stream);
-    //err = inflateInit2(&stream, -MAX_WBITS);
-    //err = inflateInit2(&stream, -15);
-    check_zlib_err(err);
+    decompress(data.data(), data.size(), result.data(), result.size());
+	return result;
+}
 
-    while (stream.total_out < result.size() && stream.total_in < data.size()) {
-        err = inflate(&stream, Z_NO_FLUSH);
-        if (err == Z_STREAM_END) break;
-        check_zlib_err(err);
-    }
+int64_t Compressor::decompress(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize) {
+    return threadLocal().decompressBlock(data, size, output, outputSize);
+}
 
-    err = inflateEnd(&stream);
-    check_zlib_err(err);
+void Compressor::compress(std::istream& input, std::ostream& output, int64_t targetSizeHint, const CompressionProfile& profile) {
+    threadLocal().compressStream(input, output, targetSizeHint, profile);
+}
 
-	return result;
+void Compressor::decompress(std::istream& input, std::ostream& output) {
+    threadLocal().decompressStream(input, output);
 }
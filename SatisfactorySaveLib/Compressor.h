@@ -3,15 +3,95 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <string>
+
+// Block (de)compression implementations, all of them produce/consume zlib streams.
+// Zlib is always available; building against zlib-ng's zlib-compatible library instead of ext/zlib needs no code change.
+// Libdeflate is compiled in when SATISFACTORY_WITH_LIBDEFLATE is defined (link libdeflate as well).
+enum class CompressionBackendType {
+	Zlib,
+	Libdeflate
+};
+
+enum class CompressionStrategy {
+	Default,
+	Filtered,
+	HuffmanOnly,
+	Rle,
+	Fixed
+};
+
+// Deflate settings, every profile produces zlib streams the game accepts
+struct CompressionProfile {
+	int level = -1; // 0 - 9, -1 = zlib default (6)
+	CompressionStrategy strategy = CompressionStrategy::Default;
+	int memLevel = 8; // 1 - 9
+	bool store = false; // stored (uncompressed) deflate blocks, for debugging
+
+	static CompressionProfile fast() { return { 1 }; }
+	static CompressionProfile archive() { return { 9, CompressionStrategy::Default, 9 }; }
+	static CompressionProfile stored() { return { 0, CompressionStrategy::Default, 8, true }; }
+
+	bool operator==(const CompressionProfile& other) const {
+		return level == other.level && strategy == other.strategy && memLevel == other.memLevel && store == other.store;
+	}
+	bool operator!=(const CompressionProfile& other) const { return !(*this == other); }
+};
+
+class CompressionBackend {
+public:
+	virtual ~CompressionBackend() = default;
+	// Backends without strategy/memLevel knobs (libdeflate) only honour level and store
+	virtual std::vector<uint8_t> compressBlock(const uint8_t* data, int64_t size, const CompressionProfile& profile) = 0;
+	virtual int64_t decompressBlock(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize) = 0;
+};
 
 class Compressor
 {
 public:
-	static std::vector<uint8_t> compress(const std::vector<uint8_t>& data);
-	static std::vector<uint8_t> compress(const uint8_t* data, int64_t size);
+	explicit Compressor(CompressionBackendType backend = defaultBackend());
+	~Compressor();
+	Compressor(const Compressor&) = delete;
+	Compressor& operator=(const Compressor&) = delete;
+
+	static bool isAvailable(CompressionBackendType backend);
+	// e.g. "zlib 1.2.11", "zlib-ng 2.1.6", "libdeflate 1.19"
+	static std::string backendName(CompressionBackendType backend);
+	// Backend of threadLocal() and the static functions, threads pick up a change on their next call
+	static void setDefaultBackend(CompressionBackendType backend);
+	static CompressionBackendType defaultBackend();
+
+	// Instance owned by the calling thread, the static functions below all go through it.
+	// Its z_streams are initialized once and only reset between calls.
+	static Compressor& threadLocal();
+
+	CompressionBackendType backend() const { return _backendType; }
+
+	std::vector<uint8_t> compressBlock(const uint8_t* data, int64_t size, const CompressionProfile& profile = {});
+	int64_t decompressBlock(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize);
+	// Streaming always goes through zlib, libdeflate has no streaming API
+	void compressStream(std::istream& input, std::ostream& output, int64_t targetSizeHint, const CompressionProfile& profile = {});
+	void decompressStream(std::istream& input, std::ostream& output);
+
+	static std::vector<uint8_t> compress(const std::vector<uint8_t>& data, const CompressionProfile& profile = {});
+	static std::vector<uint8_t> compress(const uint8_t* data, int64_t size, const CompressionProfile& profile = {});
 	static std::vector<uint8_t> decompress(const std::vector<uint8_t>& data, int64_t targetSizeHint);
+	// Inflates straight into output, returns the number of bytes written
+	static int64_t decompress(const uint8_t* data, int64_t size, uint8_t* output, int64_t outputSize);
 
-	// TODO:
-	static void compress(std::istream& input, std::ostream& output, int64_t targetSizeHint);
+	// Streaming variants working with fixed-size buffers, memory use does not depend on the data size.
+	// compress reads targetSizeHint bytes from input (until end of stream if negative),
+	// decompress reads one zlib stream and leaves input positioned right after it.
+	static void compress(std::istream& input, std::ostream& output, int64_t targetSizeHint, const CompressionProfile& profile = {});
 	static void decompress(std::istream& input, std::ostream& output);
+
+private:
+	class ZlibBackend;
+
+	CompressionBackendType _backendType;
+	std::unique_ptr<ZlibBackend> _zlib;
+	std::unique_ptr<CompressionBackend> _blockBackend; // null when blocks go through _zlib as well
+
+	CompressionBackend& _block();
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace factorygame {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    constexpr bool hostIsBigEndian = true;
+#else
+    constexpr bool hostIsBigEndian = false;
+#endif
+
+    // Converts between host order and the little-endian order of save files (a no-op on little-endian hosts)
+    template<typename T>
+    T littleEndian(T value) {
+        if constexpr (hostIsBigEndian && sizeof(T) > 1) {
+            uint8_t bytes[sizeof(T)];
+            memcpy(bytes, &value, sizeof(T));
+            for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+                std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+            }
+            memcpy(&value, bytes, sizeof(T));
+        }
+        return value;
+    }
+
+    inline uint16_t byteSwap(uint16_t value) {
+        return static_cast<uint16_t>(value >> 8 | value << 8);
+    }
+
+    inline uint32_t byteSwap(uint32_t value) {
+        return value >> 24 | (value >> 8 & 0xFF00) | (value << 8 & 0xFF0000) | value << 24;
+    }
+
+    inline uint64_t byteSwap(uint64_t value) {
+        return static_cast<uint64_t>(byteSwap(static_cast<uint32_t>(value))) << 32 | byteSwap(static_cast<uint32_t>(value >> 32));
+    }
+
+    // Converts count consecutive T in place (a no-op on little-endian hosts). values needn't be aligned for T.
+    // The loop is branch free shifts and masks per element, compilers turn it into byte shuffles on targets that have them.
+    template<typename T>
+    void littleEndianInPlace(void* values, size_t count) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "littleEndianInPlace needs a scalar type");
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported scalar size");
+        if constexpr (hostIsBigEndian && sizeof(T) > 1) {
+            using Word = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+            uint8_t* bytes = static_cast<uint8_t*>(values);
+            for (size_t ix = 0; ix < count; ++ix) {
+                Word word;
+                memcpy(&word, bytes + ix * sizeof(Word), sizeof(Word));
+                word = byteSwap(word);
+                memcpy(bytes + ix * sizeof(Word), &word, sizeof(Word));
+            }
+        }
+    }
+
+}
@@ -1,6 +1,7 @@
 #include "FactoryGameSave.h"
 
 #include "Compressor.h"
+#include "Parallel.h"
 
 namespace factorygame {
 
@@ -60,45 +61,400 @@ namespace factorygame {
     CompressedChunkHeader CompressedChunkHeader::read(std::istream& stream) {
         PropertyReader reader(stream);
         CompressedChunkHeader body;
-        body.unrealSignature = reader.readBasicType<Int>();
+        // six values, each followed by a padding int
+        Int words[headerSize / sizeof(Int)];
+        reader.readBasicTypes(words, headerSize / sizeof(Int));
         static constexpr uint32_t unrealMagic = 0x9E2A83C1;
-        if (stream.gcount() != sizeof(int32_t)) {
+        if (stream.gcount() != headerSize) {
             throw std::runtime_error("Couldn't read chunk header");
         }
+        body.unrealSignature = words[0];
         if (body.unrealSignature != unrealMagic) {
             throw std::runtime_error("unreal magic number mismatch");
         }
-        reader.readBasicType<Int>(); // padding
-        body.maxChunkSize = reader.readBasicType<Int>();
-        reader.readBasicType<Int>(); // padding
-        body.compressedSize = reader.readBasicType<Int>();
-        reader.readBasicType<Int>(); // padding
-        body.uncompressedSize = reader.readBasicType<Int>();
-        reader.readBasicType<Int>(); // padding
-        body.compressedSize2 = reader.readBasicType<Int>();
-        reader.readBasicType<Int>(); // padding
-        body.uncompressedSize2 = reader.readBasicType<Int>();
-        reader.readBasicType<Int>(); // padding
+        body.maxChunkSize = words[2];
+        body.compressedSize = words[4];
+        body.uncompressedSize = words[6];
+        body.compressedSize2 = words[8];
+        body.uncompressedSize2 = words[10];
         return body;
     }
 
     void CompressedChunkHeader::write(std::ostream& stream) const {
         PropertyWriter writer(stream);
-        Int padding{ 0 };
-        writer.writeBasicType(unrealSignature);
-        writer.writeBasicType(padding);
-        writer.writeBasicType(maxChunkSize);
-        writer.writeBasicType(padding);
-        writer.writeBasicType(compressedSize);
-        writer.writeBasicType(padding);
-        writer.writeBasicType(uncompressedSize);
-        writer.writeBasicType(padding);
-        writer.writeBasicType(compressedSize2);
-        writer.writeBasicType(padding);
-        writer.writeBasicType(uncompressedSize2);
-        writer.writeBasicType(padding);
+        const Int words[headerSize / sizeof(Int)] = { unrealSignature, 0, maxChunkSize, 0, compressedSize, 0, uncompressedSize, 0, compressedSize2, 0, uncompressedSize2, 0 };
+        writer.writeBasicTypes(words, headerSize / sizeof(Int));
+    }
+
+
+    void ActorTransforms::reserve(size_t count) {
+        for (auto* column : { &objectIndex, &typeId }) {
+            column->reserve(count);
+        }
+        for (auto* column : { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &rotW, &scaleX, &scaleY, &scaleZ }) {
+            column->reserve(count);
+        }
+    }
+
+    void ActorTransforms::add(int64_t objIx, const ActorHeader& header) {
+        objectIndex.push_back(static_cast<uint32_t>(objIx));
+        typeId.push_back(header.typePath.id());
+        posX.push_back(header.posX);
+        posY.push_back(header.posY);
+        posZ.push_back(header.posZ);
+        rotX.push_back(header.rotX);
+        rotY.push_back(header.rotY);
+        rotZ.push_back(header.rotZ);
+        rotW.push_back(header.rotW);
+        scaleX.push_back(header.scaleX);
+        scaleY.push_back(header.scaleY);
+        scaleZ.push_back(header.scaleZ);
+    }
+
+    ActorTransforms ActorTransforms::build(const std::vector<ObjectHeader>& objectHeaders) {
+        ActorTransforms result;
+        result.reserve(objectHeaders.size());
+        for (size_t objIx = 0; objIx < objectHeaders.size(); ++objIx) {
+            if (objectHeaders[objIx].headerType != 0) {
+                result.add(objIx, std::get<ActorHeader>(objectHeaders[objIx].header));
+            }
+        }
+        return result;
+    }
+
+    ActorTransforms::Bounds ActorTransforms::bounds() const {
+        if (size() == 0) {
+            return {};
+        }
+        Bounds result{ posX[0], posY[0], posZ[0], posX[0], posY[0], posZ[0] };
+        // one column per loop keeps them branch free and vectorizable
+        const size_t count = size();
+        for (size_t row = 0; row < count; ++row) {
+            result.minX = std::min(result.minX, posX[row]);
+            result.maxX = std::max(result.maxX, posX[row]);
+        }
+        for (size_t row = 0; row < count; ++row) {
+            result.minY = std::min(result.minY, posY[row]);
+            result.maxY = std::max(result.maxY, posY[row]);
+        }
+        for (size_t row = 0; row < count; ++row) {
+            result.minZ = std::min(result.minZ, posZ[row]);
+            result.maxZ = std::max(result.maxZ, posZ[row]);
+        }
+        return result;
+    }
+
+    std::vector<uint32_t> ActorTransforms::rowsInside(const Bounds& box) const {
+        const size_t count = size();
+        std::vector<uint8_t> inside(count);
+        for (size_t row = 0; row < count; ++row) {
+            inside[row] = (posX[row] >= box.minX) & (posX[row] <= box.maxX)
+                & (posY[row] >= box.minY) & (posY[row] <= box.maxY)
+                & (posZ[row] >= box.minZ) & (posZ[row] <= box.maxZ);
+        }
+        std::vector<uint32_t> rows;
+        for (size_t row = 0; row < count; ++row) {
+            if (inside[row]) {
+                rows.push_back(static_cast<uint32_t>(row));
+            }
+        }
+        return rows;
+    }
+
+    std::vector<uint32_t> ActorTransforms::rowsOfType(uint32_t type) const {
+        std::vector<uint32_t> rows;
+        for (size_t row = 0; row < typeId.size(); ++row) {
+            if (typeId[row] == type) {
+                rows.push_back(static_cast<uint32_t>(row));
+            }
+        }
+        return rows;
+    }
+
+    std::vector<int64_t> SaveFileBody::indexObjects(BodyReader& reader, Int objectCount) {
+        // both object kinds start with an Int holding the number of bytes that follow it
+        std::vector<int64_t> offsets;
+        offsets.reserve(objectCount + 1);
+        for (Int objIx = 0; objIx < objectCount; ++objIx) {
+            offsets.push_back(reader.position());
+            const Int size = reader.readBasicType<Int>();
+            reader.skip(size);
+        }
+        offsets.push_back(reader.position());
+        return offsets;
+    }
+
+    SaveFileBody SaveFileBody::readParallel(const uint8_t* data, int64_t size, unsigned threadCount, std::shared_ptr<Arena> arena, bool collectTransforms) {
+        BodyReader reader(data, size);
+        SaveFileBody body;
+        body.strings = std::make_shared<StringTable>();
+        reader.setStringTable(body.strings.get());
+        if (arena) {
+            reader.setMemoryResource(arena->newResource());
+            body.arena = std::move(arena);
+        }
+        body.uncompressedSize = reader.readBasicType<Int>();
+        body.objectHeaderCount = reader.readBasicType<Int>();
+
+        body.objectHeaders.reserve(body.objectHeaderCount);
+        if (collectTransforms) {
+            body.actorTransforms.emplace().reserve(body.objectHeaderCount);
+        }
+
+        for (int objIx = 0; objIx < body.objectHeaderCount; ++objIx) {
+            auto& header = body.objectHeaders.emplace_back(ObjectHeader::read(reader));
+            if (collectTransforms && header.headerType != 0) {
+                body.actorTransforms->add(objIx, std::get<ActorHeader>(header.header));
+            }
+        }
+
+        body.objectCount = reader.readBasicType<Int>();
+
+        if (body.objectHeaderCount != body.objectCount) {
+            // The header of the same index tells whether an object is an actor or a component, objects can't be
+            // decoded without one each. Like read(), the body is returned with its headers only.
+            return body;
+        }
+
+        const auto offsets = indexObjects(reader, body.objectCount);
+
+        // objects are handed out in batches, each with its own arena resource
+        constexpr int64_t objectsPerJob = 1024;
+        const int64_t jobCount = (body.objectCount + objectsPerJob - 1) / objectsPerJob;
+        body.objects.resize(body.objectCount);
+        parallelFor(jobCount, threadCount, [&](int64_t jobIx) {
+            std::pmr::memory_resource* resource = body.arena ? body.arena->newResource() : nullptr;
+            const int64_t last = std::min<int64_t>(body.objectCount, (jobIx + 1) * objectsPerJob);
+            for (int64_t objIx = jobIx * objectsPerJob; objIx < last; ++objIx) {
+                BodyReader objectReader(data + offsets[objIx], offsets[objIx + 1] - offsets[objIx]);
+                objectReader.setMemoryResource(resource);
+                body.objects[objIx] = Object::read(objectReader, body.objectHeaders[objIx]);
+            }
+        });
+
+        body.collectedObjectsCount = reader.readBasicType<Int>();
+
+        for (int collectedObjIx = 0; collectedObjIx < body.collectedObjectsCount; ++collectedObjIx) {
+            body.collectedObjects.emplace_back(ObjectReference::read(reader));
+        }
+
+        return body;
+    }
+
+    SaveFileBodyView::SaveFileBodyView(std::shared_ptr<const ByteBuffer> data, bool collectTransforms) : _data(std::move(data)), _strings(std::make_shared<StringTable>()) {
+        BodyReader reader(*_data);
+        reader.setStringTable(_strings.get());
+        _uncompressedSize = reader.readBasicType<Int>();
+        const Int objectHeaderCount = reader.readBasicType<Int>();
+
+        _objectHeaders.reserve(objectHeaderCount);
+        if (collectTransforms) {
+            _actorTransforms.emplace().reserve(objectHeaderCount);
+        }
+
+        for (int objIx = 0; objIx < objectHeaderCount; ++objIx) {
+            auto& header = _objectHeaders.emplace_back(ObjectHeader::read(reader));
+            if (collectTransforms && header.headerType != 0) {
+                _actorTransforms->add(objIx, std::get<ActorHeader>(header.header));
+            }
+        }
+
+        _objectCount = reader.readBasicType<Int>();
+
+        if (objectHeaderCount != _objectCount) {
+            // Objects are told apart by the header of the same index, without one each they can't be indexed.
+            // As with SaveFileBody::read, only the headers are kept: objectCount() is 0, collected objects are empty.
+            _objectOffsets.push_back(reader.position());
+            return;
+        }
+
+        _objectOffsets = SaveFileBody::indexObjects(reader, _objectCount);
+
+        const Int collectedObjectsCount = reader.readBasicType<Int>();
+
+        for (int collectedObjIx = 0; collectedObjIx < collectedObjectsCount; ++collectedObjIx) {
+            _collectedObjects.emplace_back(ObjectReference::read(reader));
+        }
+    }
+
+    const Object& SaveFileBodyView::object(int64_t objIx) const {
+        if (objIx < 0 || objIx >= objectCount()) {
+            throw std::out_of_range("Object index out of range");
+        }
+        if (_objects.empty()) {
+            _objects.resize(objectCount());
+        }
+        auto& slot = _objects[objIx];
+        if (!slot) {
+            BodyReader reader(objectData(objIx), objectSize(objIx));
+            slot = std::make_unique<Object>(Object::read(reader, _objectHeaders[objIx]));
+        }
+        return *slot;
+    }
+
+    SaveFileBody SaveFileBodyView::materialize(unsigned threadCount) const {
+        SaveFileBody body;
+        body.strings = _strings;
+        body.uncompressedSize = _uncompressedSize;
+        body.objectHeaderCount = static_cast<Int>(_objectHeaders.size());
+        body.objectCount = _objectCount;
+        body.objectHeaders = _objectHeaders;
+        body.actorTransforms = _actorTransforms;
+        if (body.objectHeaderCount != body.objectCount) {
+            return body;
+        }
+
+        body.objects.resize(objectCount());
+        parallelFor(objectCount(), threadCount, [&](int64_t objIx) {
+            if (!_objects.empty() && _objects[objIx]) {
+                body.objects[objIx] = *_objects[objIx];
+                return;
+            }
+            BodyReader reader(objectData(objIx), objectSize(objIx));
+            body.objects[objIx] = Object::read(reader, _objectHeaders[objIx]);
+        });
+
+        body.collectedObjectsCount = static_cast<Int>(_collectedObjects.size());
+        body.collectedObjects = _collectedObjects;
+        return body;
+    }
+
+    // Placement of a serialized body. Each job is a run of consecutive headers, objects or collected objects.
+    // Sizes are summed in parallel, a prefix sum places the jobs and the count fields between the three lists.
+    struct SerializedBodyLayout {
+        struct Job {
+            int list;
+            int64_t first;
+            int64_t last;
+            int64_t offset;
+            int64_t size;
+        };
+
+        std::vector<Job> jobs;
+        int64_t countFieldOffsets[3] = {};
+        int64_t size = 0;
+    };
+
+    template<typename Fn>
+    static void forEachItem(const SaveFileBody& body, const SerializedBodyLayout::Job& job, Fn&& fn) {
+        for (int64_t ix = job.first; ix < job.last; ++ix) {
+            if (job.list == 0) {
+                fn(body.objectHeaders[ix]);
+            } else if (job.list == 1) {
+                fn(body.objects[ix]);
+            } else {
+                fn(body.collectedObjects[ix]);
+            }
+        }
+    }
+
+    static SerializedBodyLayout layoutBody(const SaveFileBody& body, unsigned threadCount) {
+        constexpr int64_t itemsPerJob = 2048;
+        const int64_t listSizes[3] = { (int64_t)body.objectHeaders.size(), (int64_t)body.objects.size(), (int64_t)body.collectedObjects.size() };
+
+        SerializedBodyLayout layout;
+        auto& jobs = layout.jobs;
+        for (int list = 0; list < 3; ++list) {
+            for (int64_t first = 0; first < listSizes[list]; first += itemsPerJob) {
+                jobs.push_back({ list, first, std::min(first + itemsPerJob, listSizes[list]), 0, 0 });
+            }
+        }
+
+        parallelFor(jobs.size(), threadCount, [&](int64_t jobIx) {
+            auto& job = jobs[jobIx];
+            forEachItem(body, job, [&](auto& item) { job.size += item.serializedSize(); });
+        });
+
+        int64_t offset = sizeof(Int); // uncompressedSize
+        size_t jobIx = 0;
+        for (int list = 0; list < 3; ++list) {
+            layout.countFieldOffsets[list] = offset;
+            offset += sizeof(Int);
+            for (; jobIx < jobs.size() && jobs[jobIx].list == list; ++jobIx) {
+                jobs[jobIx].offset = offset;
+                offset += jobs[jobIx].size;
+            }
+        }
+        layout.size = offset;
+        return layout;
+    }
+
+    // Writes the uncompressedSize and count fields that start in [begin, end), out holds the body bytes from begin
+    static void writeBodyFields(const SaveFileBody& body, const SerializedBodyLayout& layout, int64_t begin, int64_t end, uint8_t* out) {
+        const int64_t offsets[4] = { 0, layout.countFieldOffsets[0], layout.countFieldOffsets[1], layout.countFieldOffsets[2] };
+        const Int values[4] = { static_cast<Int>(layout.size - sizeof(Int)), body.objectHeaderCount, body.objectCount, body.collectedObjectsCount };
+        for (int field = 0; field < 4; ++field) {
+            if (offsets[field] >= begin && offsets[field] < end) {
+                BodyWriter(out + (offsets[field] - begin), sizeof(Int)).writeBasicType(values[field]);
+            }
+        }
+    }
+
+    static void writeBodyJob(const SaveFileBody& body, const SerializedBodyLayout::Job& job, uint8_t* out) {
+        BodyWriter writer(out, job.size);
+        forEachItem(body, job, [&](auto& item) { item.write(writer); });
+        if (writer.remaining() != 0) {
+            throw std::runtime_error("Serialized size mismatch");
+        }
+    }
+
+    ByteBuffer SaveFileBody::serialize(unsigned threadCount) const {
+        const auto layout = layoutBody(*this, threadCount);
+
+        ByteBuffer result;
+        result.resize(layout.size);
+        writeBodyFields(*this, layout, 0, layout.size, result.data());
+        parallelFor(layout.jobs.size(), threadCount, [&](int64_t jobIx) {
+            auto& job = layout.jobs[jobIx];
+            writeBodyJob(*this, job, result.data() + job.offset);
+        });
+        return result;
     }
 
+    void SaveFileBody::serializeWindows(unsigned threadCount, int64_t windowSize, const std::function<void(const uint8_t*, int64_t)>& consume) const {
+        const auto layout = layoutBody(*this, threadCount);
+        auto& jobs = layout.jobs;
+
+        // windows end at job boundaries, so every job and fixed field lies within one window
+        struct Window {
+            size_t firstJob;
+            size_t lastJob;
+            int64_t begin;
+            int64_t end;
+        };
+        std::vector<Window> windows;
+        Window current{ 0, 0, 0, 0 };
+        for (size_t jobIx = 0; jobIx < jobs.size(); ++jobIx) {
+            if (jobs[jobIx].offset - current.begin >= windowSize) {
+                current.lastJob = jobIx;
+                current.end = jobs[jobIx].offset;
+                windows.push_back(current);
+                current = { jobIx, jobIx, jobs[jobIx].offset, 0 };
+            }
+        }
+        current.lastJob = jobs.size();
+        current.end = layout.size;
+        windows.push_back(current);
+
+        // a batch of windows is written in parallel, then handed out in order
+        const int64_t batchSize = threadCount == 0 ? defaultThreadCount() : threadCount;
+        std::vector<ByteBuffer> buffers(std::min<int64_t>(batchSize, windows.size()));
+        for (int64_t batchStart = 0; batchStart < (int64_t)windows.size(); batchStart += batchSize) {
+            const int64_t batchCount = std::min<int64_t>(batchSize, windows.size() - batchStart);
+            parallelFor(batchCount, threadCount, [&](int64_t ix) {
+                auto& window = windows[batchStart + ix];
+                auto& buffer = buffers[ix];
+                buffer.resize(window.end - window.begin);
+                writeBodyFields(*this, layout, window.begin, window.end, buffer.data());
+                for (size_t jobIx = window.firstJob; jobIx < window.lastJob; ++jobIx) {
+                    writeBodyJob(*this, jobs[jobIx], buffer.data() + (jobs[jobIx].offset - window.begin));
+                }
+            });
+            for (int64_t ix = 0; ix < batchCount; ++ix) {
+                consume(buffers[ix].data(), buffers[ix].size());
+            }
+        }
+    }
 
     std::vector<CompressedChunkInfo> SaveFileLoader::_collectChunkPositions(std::istream& stream) {
         std::vector<CompressedChunkInfo> chunks;
@@ -128,25 +484,200 @@ namespace factorygame {
         _chunks = _collectChunkPositions(ifs);
     }
 
-    std::vector<uint8_t> SaveFileLoader::decompressChunks(const factorygame::SaveFileLoader& loader, std::istream& fileStream) {
-        std::vector<uint8_t> result;
+    ByteBuffer SaveFileLoader::decompressChunks(const factorygame::SaveFileLoader& loader, std::istream& fileStream, unsigned threadCount) {
         auto& chunks = loader.chunks();
+        const int64_t chunkCount = chunks.size();
+
+        // every chunk's slot in the result is known up front
+        std::vector<int64_t> dstOffsets(chunkCount);
         int64_t uncompressedSizeSum = 0;
-        for (auto& chunk : chunks) {
-            uncompressedSizeSum += chunk.uncompressedSize;
+        for (int64_t chunkIx = 0; chunkIx < chunkCount; ++chunkIx) {
+            dstOffsets[chunkIx] = uncompressedSizeSum;
+            uncompressedSizeSum += chunks[chunkIx].uncompressedSize;
         }
-        result.reserve(uncompressedSizeSum);
-        for (auto& chunk : chunks) {
+
+        // file reads stay sequential, only inflating is spread across threads
+        std::vector<std::vector<uint8_t>> compressedChunks(chunkCount);
+        for (int64_t chunkIx = 0; chunkIx < chunkCount; ++chunkIx) {
+            auto& chunk = chunks[chunkIx];
+            auto& buffer = compressedChunks[chunkIx];
             fileStream.seekg(chunk.pos);
-            std::vector<uint8_t> buffer;
             buffer.resize(chunk.compressedSize);
             fileStream.read((char*)buffer.data(), chunk.compressedSize);
-            auto uncompressedData = Compressor::decompress(buffer, chunk.uncompressedSize);
-            result.resize(result.size() + uncompressedData.size());
-            auto dstStart = &result.at(result.size() - uncompressedData.size());
-            memcpy((char*)dstStart, uncompressedData.data(), uncompressedData.size());
+            if (fileStream.gcount() != chunk.compressedSize) {
+                throw std::runtime_error("Couldn't read compressed chunk");
+            }
+        }
+
+        ByteBuffer result;
+        result.resize(uncompressedSizeSum);
+        parallelFor(chunkCount, threadCount, [&](int64_t chunkIx) {
+            auto& chunk = chunks[chunkIx];
+            auto& compressed = compressedChunks[chunkIx];
+            auto written = Compressor::decompress(compressed.data(), compressed.size(), result.data() + dstOffsets[chunkIx], chunk.uncompressedSize);
+            if (written != chunk.uncompressedSize) {
+                throw std::runtime_error("Decompressed chunk size mismatch");
+            }
+            std::vector<uint8_t>().swap(compressed);
+        });
+        return result;
+    }
+
+    ByteBuffer SaveFileLoader::decompressChunks(const factorygame::SaveFileLoader& loader, const MappedFile& file, unsigned threadCount) {
+        auto& chunks = loader.chunks();
+        const int64_t chunkCount = chunks.size();
+
+        std::vector<int64_t> dstOffsets(chunkCount);
+        int64_t uncompressedSizeSum = 0;
+        for (int64_t chunkIx = 0; chunkIx < chunkCount; ++chunkIx) {
+            auto& chunk = chunks[chunkIx];
+            if (chunk.pos < 0 || chunk.compressedSize < 0 || chunk.pos + chunk.compressedSize > file.size()) {
+                throw std::runtime_error("Compressed chunk out of file bounds");
+            }
+            dstOffsets[chunkIx] = uncompressedSizeSum;
+            uncompressedSizeSum += chunk.uncompressedSize;
         }
+
+        ByteBuffer result;
+        result.resize(uncompressedSizeSum);
+        parallelFor(chunkCount, threadCount, [&](int64_t chunkIx) {
+            auto& chunk = chunks[chunkIx];
+            auto written = Compressor::decompress(file.data() + chunk.pos, chunk.compressedSize, result.data() + dstOffsets[chunkIx], chunk.uncompressedSize);
+            if (written != chunk.uncompressedSize) {
+                throw std::runtime_error("Decompressed chunk size mismatch");
+            }
+        });
         return result;
     }
 
-}
\ No newline at end of file
+    // Runs parse on a reader that inflates the chunks on threadCount threads, at most window chunks ahead
+    static void parseInflating(const SaveFileLoader& loader, const MappedFile& file, unsigned threadCount, int64_t window, const std::function<void(BodyReader&)>& parse) {
+        auto& chunks = loader.chunks();
+        for (auto& chunk : chunks) {
+            if (chunk.pos < 0 || chunk.compressedSize < 0 || chunk.pos + chunk.compressedSize > file.size()) {
+                throw std::runtime_error("Compressed chunk out of file bounds");
+            }
+        }
+
+        OrderedProducer<ByteBuffer> producer(chunks.size(), threadCount, window, [&](int64_t chunkIx) {
+            auto& chunk = chunks[chunkIx];
+            ByteBuffer uncompressedData;
+            uncompressedData.resize(chunk.uncompressedSize);
+            auto written = Compressor::decompress(file.data() + chunk.pos, chunk.compressedSize, uncompressedData.data(), chunk.uncompressedSize);
+            if (written != chunk.uncompressedSize) {
+                throw std::runtime_error("Decompressed chunk size mismatch");
+            }
+            return uncompressedData;
+        });
+
+        BodyReader reader([&](ByteBuffer& chunk) { return producer.next(chunk); });
+        parse(reader);
+    }
+
+    SaveFileBody SaveFileLoader::readBodyStreaming(const factorygame::SaveFileLoader& loader, const MappedFile& file, unsigned threadCount, int64_t window) {
+        SaveFileBody body;
+        parseInflating(loader, file, threadCount, window, [&](BodyReader& reader) {
+            body = SaveFileBody::read(reader);
+        });
+        return body;
+    }
+
+    SaveFileBody SaveFileLoader::readBodyStreaming(const factorygame::SaveFileLoader& loader, const MappedFile& file, const ObjectVisitor& visitObject, unsigned threadCount, int64_t window) {
+        SaveFileBody body;
+        parseInflating(loader, file, threadCount, window, [&](BodyReader& reader) {
+            body.strings = std::make_shared<StringTable>();
+            reader.setStringTable(body.strings.get());
+            body.uncompressedSize = reader.readBasicType<Int>();
+            body.objectHeaderCount = reader.readBasicType<Int>();
+
+            body.objectHeaders.reserve(body.objectHeaderCount);
+            for (int objIx = 0; objIx < body.objectHeaderCount; ++objIx) {
+                body.objectHeaders.emplace_back(ObjectHeader::read(reader));
+            }
+
+            body.objectCount = reader.readBasicType<Int>();
+
+            if (body.objectHeaderCount != body.objectCount) {
+                // objects can't be decoded without the header of the same index, like read() only the headers are returned
+                return;
+            }
+
+            for (int objIx = 0; objIx < body.objectCount; ++objIx) {
+                visitObject(objIx, body.objectHeaders[objIx], Object::read(reader, body.objectHeaders[objIx]));
+            }
+
+            body.collectedObjectsCount = reader.readBasicType<Int>();
+            for (int collectedObjIx = 0; collectedObjIx < body.collectedObjectsCount; ++collectedObjIx) {
+                body.collectedObjects.emplace_back(ObjectReference::read(reader));
+            }
+        });
+        return body;
+    }
+
+    ChunkCompressingStreamBuf::ChunkCompressingStreamBuf(std::ostream& target, int64_t chunkSize, unsigned threadCount, const CompressionProfile& profile)
+        : _target(target), _chunkSize(chunkSize), _profile(profile), _pool(threadCount), _window(2 * _pool.threadCount()) {
+        _block.resize(_chunkSize);
+        setp((char*)_block.data(), (char*)_block.data() + _block.size());
+    }
+
+    ChunkCompressingStreamBuf::int_type ChunkCompressingStreamBuf::overflow(int_type ch) {
+        if (pptr() == epptr()) {
+            _submitBlock();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    void ChunkCompressingStreamBuf::_submitBlock() {
+        const int64_t size = pptr() - pbase();
+        _block.resize(size);
+        const CompressionProfile profile = _profile;
+        auto compressed = _pool.submit([block = std::move(_block), profile]() {
+            return Compressor::compress(block.data(), block.size(), profile);
+        });
+        _pending.emplace_back(size, std::move(compressed));
+        ++_chunkCount;
+
+        while (_pending.size() > _window) {
+            _writeFront();
+        }
+        _block = ByteBuffer();
+        _block.resize(_chunkSize);
+        setp((char*)_block.data(), (char*)_block.data() + _block.size());
+    }
+
+    void ChunkCompressingStreamBuf::_writeFront() {
+        auto uncompressedSize = _pending.front().first;
+        auto data = _pending.front().second.get();
+        _pending.pop_front();
+        SaveFileWriter::_writeChunk(_target, SaveFileWriter::CompressedChunk{ uncompressedSize, std::move(data) });
+        if (!_target) {
+            throw std::runtime_error("Couldn't write compressed chunk");
+        }
+    }
+
+    void ChunkCompressingStreamBuf::finish() {
+        if (pptr() != pbase() || _chunkCount == 0) {
+            _submitBlock();
+        }
+        while (!_pending.empty()) {
+            _writeFront();
+        }
+    }
+
+    void SaveFileWriter::save(std::ostream& stream, const SaveFileHeader& header, const SaveFileBody& body, unsigned threadCount, const CompressionProfile& profile) {
+        header.write(stream);
+
+        // windows of the body are serialized by object range on threadCount threads while the sink compresses
+        // the blocks cut from earlier windows, the leading uncompressedSize comes out right from the layout
+        ChunkCompressingStreamBuf sink(stream, chunkSize, threadCount, profile);
+        body.serializeWindows(threadCount, 8 * chunkSize, [&](const uint8_t* data, int64_t size) {
+            sink.sputn((const char*)data, size);
+        });
+        sink.finish();
+    }
+
+}
@@ -4,12 +4,26 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <iterator>
 #include <vector>
 #include <variant>
-
+#include <deque>
+#include <functional>
+#include <future>
+#include <optional>
+#include <memory>
+#include <streambuf>
+
+#include "Arena.h"
+#include "ByteBuffer.h"
 #include "Properties.h"
+#include "StringTable.h"
 #include "PropertyReader.h"
+#include "BodyReader.h"
+#include "BodyWriter.h"
 #include "Compressor.h"
+#include "MappedFile.h"
+#include "Parallel.h"
 
 namespace factorygame {
 
@@ -29,13 +43,14 @@ namespace factorygame {
 
         std::string toString() const;
 
+        // String::size counts characters, UTF-16 strings take two bytes each, so the size comes from what is written
         int64_t headerSize() const {
-            constexpr int64_t intSize = 4;
-            constexpr int64_t longSize = 8;
-            constexpr int64_t byteSize = 1;
-            constexpr int64_t stringSizeSize = 4;
-            int64_t baseSizeWithoutStringContent = 1 * byteSize + 6 * intSize + 1 * longSize + 4 * stringSizeSize;
-            return baseSizeWithoutStringContent + mapName.size + mapOptions.size + sessionName.size + modMetaData.size;
+            return serializedSize();
+        }
+
+        int64_t serializedSize() const {
+            return 1 * sizeof(Byte) + 6 * sizeof(Int) + 1 * sizeof(Long)
+                + mapName.serializedSize() + mapOptions.serializedSize() + sessionName.serializedSize() + modMetaData.serializedSize();
         }
 
         bool hasCompressedBody() const {
@@ -54,8 +69,8 @@ namespace factorygame {
 
 
     struct ActorHeader {
-        String typePath;
-        String rootObject;
+        InternedString typePath;
+        InternedString rootObject;
         String instanceName;
         Int needTransform;
         Float rotX;
@@ -70,72 +85,82 @@ namespace factorygame {
         Float scaleZ;
         Int wasPlacedInLevel;
 
-        static ActorHeader read(std::istream& stream) {
+        static ActorHeader read(BodyReader& reader) {
             ActorHeader header;
-            PropertyReader reader(stream);
-            header.typePath = reader.readBasicType<String>();
-            header.rootObject = reader.readBasicType<String>();
+            header.typePath = reader.readBasicType<InternedString>();
+            header.rootObject = reader.readBasicType<InternedString>();
             header.instanceName = reader.readBasicType<String>();
             header.needTransform = reader.readBasicType<Int>();
 
-            header.rotX = reader.readBasicType<Float>();
-            header.rotY = reader.readBasicType<Float>();
-            header.rotZ = reader.readBasicType<Float>();
-            header.rotW = reader.readBasicType<Float>();
+            // rotation, position, scale in one copy
+            Float transform[10];
+            reader.readBasicTypes(transform, 10);
+            header.rotX = transform[0];
+            header.rotY = transform[1];
+            header.rotZ = transform[2];
+            header.rotW = transform[3];
 
-            header.posX = reader.readBasicType<Float>();
-            header.posY = reader.readBasicType<Float>();
-            header.posZ = reader.readBasicType<Float>();
+            header.posX = transform[4];
+            header.posY = transform[5];
+            header.posZ = transform[6];
 
-            header.scaleX = reader.readBasicType<Float>();
-            header.scaleY = reader.readBasicType<Float>();
-            header.scaleZ = reader.readBasicType<Float>();
+            header.scaleX = transform[7];
+            header.scaleY = transform[8];
+            header.scaleZ = transform[9];
 
             header.wasPlacedInLevel = reader.readBasicType<Int>();
 
             return header;
         }
 
+        // including the leading header type
+        int64_t serializedSize() const {
+            return 3 * sizeof(Int) + 10 * sizeof(Float)
+                + typePath.serializedSize() + rootObject.serializedSize() + instanceName.serializedSize();
+        }
+
         void write(std::ostream& stream) const {
-            PropertyWriter writer(stream);
+            writeToStream(*this, stream);
+        }
+
+        void write(BodyWriter& writer) const {
             writer.writeBasicType(Int{ (int)1 });
             writer.writeBasicType(typePath);
             writer.writeBasicType(rootObject);
             writer.writeBasicType(instanceName);
 
             writer.writeBasicType(needTransform);
-            writer.writeBasicType(rotX);
-            writer.writeBasicType(rotY);
-            writer.writeBasicType(rotZ);
-            writer.writeBasicType(rotW);
-            writer.writeBasicType(posX);
-            writer.writeBasicType(posY);
-            writer.writeBasicType(posZ);
-            writer.writeBasicType(scaleX);
-            writer.writeBasicType(scaleY);
-            writer.writeBasicType(scaleZ);
+            const Float transform[10] = { rotX, rotY, rotZ, rotW, posX, posY, posZ, scaleX, scaleY, scaleZ };
+            writer.writeBasicTypes(transform, 10);
             writer.writeBasicType(wasPlacedInLevel);
         }
     };
 
     struct ComponentHeader {
-        String typePath;
-        String rootObject;
+        InternedString typePath;
+        InternedString rootObject;
         String instanceName;
-        String parentActorName;
+        InternedString parentActorName;
 
-        static ComponentHeader read(std::istream& stream) {
+        static ComponentHeader read(BodyReader& reader) {
             ComponentHeader header;
-            PropertyReader reader(stream);
-            header.typePath = reader.readBasicType<String>();
-            header.rootObject = reader.readBasicType<String>();
+            header.typePath = reader.readBasicType<InternedString>();
+            header.rootObject = reader.readBasicType<InternedString>();
             header.instanceName = reader.readBasicType<String>();
-            header.parentActorName = reader.readBasicType<String>();
+            header.parentActorName = reader.readBasicType<InternedString>();
             return header;
         }
 
+        // including the leading header type
+        int64_t serializedSize() const {
+            return sizeof(Int) + typePath.serializedSize() + rootObject.serializedSize() + instanceName.serializedSize() + parentActorName.serializedSize();
+        }
+
         void write(std::ostream& stream) const {
-            PropertyWriter writer(stream);
+            writeToStream(*this, stream);
+        }
+
+        void write(BodyWriter& writer) const {
             writer.writeBasicType(Int{(int)0});
             writer.writeBasicType(typePath);
             writer.writeBasicType(rootObject);
@@ -150,17 +175,68 @@ namespace factorygame {
 
         std::variant<ActorHeader, ComponentHeader> header;
 
-        static ObjectHeader read(std::istream& stream) {
+        static ObjectHeader read(BodyReader& reader) {
             ObjectHeader header;
-            PropertyReader reader(stream);
             header.headerType = reader.readBasicType<Int>();
             if (header.headerType == 0) {
-                header.header = ComponentHeader::read(stream);
+                header.header = ComponentHeader::read(reader);
             } else {
-                header.header = ActorHeader::read(stream);
+                header.header = ActorHeader::read(reader);
             }
             return header;
         }
+
+        int64_t serializedSize() const {
+            if (headerType == 0) {
+                return std::get<ComponentHeader>(header).serializedSize();
+            }
+            return std::get<ActorHeader>(header).serializedSize();
+        }
+
+        void write(std::ostream& stream) const {
+            if (headerType == 0) {
+                std::get<ComponentHeader>(header).write(stream);
+            } else {
+                std::get<ActorHeader>(header).write(stream);
+            }
+        }
+
+        void write(BodyWriter& writer) const {
+            if (headerType == 0) {
+                std::get<ComponentHeader>(header).write(writer);
+            } else {
+                std::get<ActorHeader>(header).write(writer);
+            }
+        }
+    };
+
+    // Structure-of-arrays copy of the actor transforms of a body, one row per actor header, for spatial
+    // queries that would otherwise walk the scattered ObjectHeader variants
+    struct ActorTransforms {
+        struct Bounds {
+            Float minX, minY, minZ;
+            Float maxX, maxY, maxZ;
+        };
+
+        std::vector<uint32_t> objectIndex; // into SaveFileBody::objectHeaders
+        std::vector<uint32_t> typeId; // InternedString::id() of the type path
+        std::vector<Float> posX, posY, posZ;
+        std::vector<Float> rotX, rotY, rotZ, rotW;
+        std::vector<Float> scaleX, scaleY, scaleZ;
+
+        size_t size() const { return objectIndex.size(); }
+
+        void reserve(size_t count);
+        void add(int64_t objIx, const ActorHeader& header);
+
+        static ActorTransforms build(const std::vector<ObjectHeader>& objectHeaders);
+
+        // bounding box of all positions, every component is 0 when there are no actors
+        Bounds bounds() const;
+        // rows with the position inside the box (inclusive)
+        std::vector<uint32_t> rowsInside(const Bounds& box) const;
+        // rows of the given type
+        std::vector<uint32_t> rowsOfType(uint32_t type) const;
     };
 
     struct ActorObjectRaw {
@@ -169,56 +245,73 @@ namespace factorygame {
         String parentObjectName;
         Int componentCount{};
 
-        std::vector<uint8_t> raw;
+        ArenaVector<uint8_t> raw;
         // components...
         // properties...
         // trailing bytes...
 
-        static ActorObjectRaw read(std::istream& stream) {
-            PropertyReader reader(stream);
+        static ActorObjectRaw read(BodyReader& reader) {
             ActorObjectRaw result;
             result.size = reader.readBasicType<Int>();
+            // size counts the bytes after it, the parent strings take 2 bytes per character when they are UTF-16
+            const int64_t start = reader.position();
             result.parentObjectRoot = reader.readBasicType<String>();
             result.parentObjectName = reader.readBasicType<String>();
             result.componentCount = reader.readBasicType<Int>();
-            auto rawSize = result.size - 1 * sizeof(int32_t) - 2 * sizeof(int32_t) - result.parentObjectName.size - result.parentObjectRoot.size;
-            result.raw.resize(rawSize);
-            stream.read((char*)result.raw.data(), rawSize);
+            const int64_t rawSize = result.size - (reader.position() - start);
+            if (rawSize < 0) {
+                throw std::runtime_error("Actor object size is smaller than its header");
+            }
+            result.raw = ArenaVector<uint8_t>(rawSize, reader.memoryResource());
+            reader.readBytes(result.raw.data(), rawSize);
             return result;
         }
 
         void write(std::ostream& stream) const {
-            PropertyWriter writer(stream);
+            writeToStream(*this, stream);
+        }
+
+        void write(BodyWriter& writer) const {
             writer.writeBasicType(size);
             writer.writeBasicType(parentObjectRoot);
             writer.writeBasicType(parentObjectName);
             writer.writeBasicType(componentCount);
-            /*if (raw.size())*/ stream.write((const char*)raw.data(), raw.size());
+            writer.writeBytes(raw.data(), raw.size());
+        }
+
+        int64_t serializedSize() const {
+            return 2 * sizeof(Int) + parentObjectRoot.serializedSize() + parentObjectName.serializedSize() + raw.size();
         }
     };
 
     struct ComponentObjectRaw {
         Int size{};
 
-        std::vector<uint8_t> raw;
+        ArenaVector<uint8_t> raw;
         // properties...
         // trailing bytes...
 
-        static ComponentObjectRaw read(std::istream& stream) {
-            PropertyReader reader(stream);
+        static ComponentObjectRaw read(BodyReader& reader) {
             ComponentObjectRaw result;
             result.size = reader.readBasicType<Int>();
 
             auto rawSize = result.size;
-            result.raw.resize(rawSize);
-            stream.read((char*)result.raw.data(), rawSize);
+            result.raw = ArenaVector<uint8_t>(rawSize, reader.memoryResource());
+            reader.readBytes(result.raw.data(), rawSize);
             return result;
         }
 
         void write(std::ostream& stream) const {
-            PropertyWriter writer(stream);
+            writeToStream(*this, stream);
+        }
+
+        void write(BodyWriter& writer) const {
             writer.writeBasicType(size);
-            /*if (raw.size()) */ stream.write((const char*)raw.data(), raw.size());
+            writer.writeBytes(raw.data(), raw.size());
+        }
+
+        int64_t serializedSize() const {
+            return sizeof(Int) + raw.size();
         }
     };
 
@@ -226,6 +319,14 @@ namespace factorygame {
         ObjectType type;
         std::variant<ComponentObjectRaw, ActorObjectRaw> object;
 
+        // the kind of object is given by its header
+        static Object read(BodyReader& reader, const ObjectHeader& header) {
+            if (header.headerType == 0) {
+                return { ObjectType::Component, ComponentObjectRaw::read(reader) };
+            }
+            return { ObjectType::Actor, ActorObjectRaw::read(reader) };
+        }
+
         void write(std::ostream& stream) const {
             if (type == ObjectType::Component) {
                 std::get<ComponentObjectRaw>(object).write(stream);
@@ -233,30 +334,60 @@ namespace factorygame {
                 std::get<ActorObjectRaw>(object).write(stream);
             }
         }
+
+        void write(BodyWriter& writer) const {
+            if (type == ObjectType::Component) {
+                std::get<ComponentObjectRaw>(object).write(writer);
+            } else {
+                std::get<ActorObjectRaw>(object).write(writer);
+            }
+        }
+
+        int64_t serializedSize() const {
+            if (type == ObjectType::Component) {
+                return std::get<ComponentObjectRaw>(object).serializedSize();
+            }
+            return std::get<ActorObjectRaw>(object).serializedSize();
+        }
     };
 
     struct ObjectReference {
-        String levelName;
+        InternedString levelName;
         String pathName;
 
-        static ObjectReference read(std::istream& stream) {
-            PropertyReader reader(stream);
+        static ObjectReference read(BodyReader& reader) {
             ObjectReference result;
-            result.levelName = reader.readBasicType<String>();
+            result.levelName = reader.readBasicType<InternedString>();
             result.pathName = reader.readBasicType<String>();
             return result;
         }
 
         void write(std::ostream& stream) const {
-            PropertyWriter writer(stream);
+            writeToStream(*this, stream);
+        }
+
+        void write(BodyWriter& writer) const {
             writer.writeBasicType(levelName);
             writer.writeBasicType(pathName);
         }
 
+        int64_t serializedSize() const {
+            return levelName.serializedSize() + pathName.serializedSize();
+        }
+
     };
 
     
     struct SaveFileBody {
+        // Set when the body was parsed into an arena, declared first so it outlives the strings and payloads
+        // allocated from it. Moving those out of the body is only safe while the arena is kept alive.
+        std::shared_ptr<Arena> arena;
+        // Owner of the interned header strings (type paths, root objects, parent actors, level names),
+        // null when the caller provided the reader's table
+        std::shared_ptr<StringTable> strings;
+        // filled while parsing when requested
+        std::optional<ActorTransforms> actorTransforms;
+
         Int uncompressedSize{};
         Int objectHeaderCount{};
         Int objectCount{};
@@ -266,16 +397,34 @@ namespace factorygame {
         std::vector<Object> objects;
         std::vector<ObjectReference> collectedObjects;
 
+        static SaveFileBody read(const std::vector<uint8_t>& data) {
+            BodyReader reader(data);
+            return read(reader);
+        }
+
+        static SaveFileBody read(const ByteBuffer& data) {
+            BodyReader reader(data);
+            return read(reader);
+        }
+
         static SaveFileBody read(std::istream& stream) {
-            PropertyReader reader(stream);
+            std::vector<uint8_t> data{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+            return read(data);
+        }
+
+        static SaveFileBody read(BodyReader& reader) {
             SaveFileBody header;
+            if (!reader.stringTable()) {
+                header.strings = std::make_shared<StringTable>();
+                reader.setStringTable(header.strings.get());
+            }
             header.uncompressedSize = reader.readBasicType<Int>();
             header.objectHeaderCount = reader.readBasicType<Int>();
 
             header.objectHeaders.reserve(header.objectHeaderCount);
 
             for (int objIx = 0; objIx < header.objectHeaderCount; ++objIx) {
-                header.objectHeaders.emplace_back(ObjectHeader::read(stream));
+                header.objectHeaders.emplace_back(ObjectHeader::read(reader));
             }
 
             header.objectCount = reader.readBasicType<Int>();
@@ -286,33 +435,39 @@ namespace factorygame {
             }
 
             for (int objIx = 0; objIx < header.objectCount; ++objIx) {
-                if (header.objectHeaders[objIx].headerType == 0) {
-                    header.objects.push_back({ObjectType::Component, ComponentObjectRaw::read(stream) });
-                } else {
-                    header.objects.push_back({ ObjectType::Actor, ActorObjectRaw::read(stream) });
-                }
+                header.objects.push_back(Object::read(reader, header.objectHeaders[objIx]));
             }
 
             header.collectedObjectsCount = reader.readBasicType<Int>();
 
             for (int collectedObjIx = 0; collectedObjIx < header.collectedObjectsCount; ++collectedObjIx) {
-                header.collectedObjects.emplace_back(ObjectReference::read(stream));
+                header.collectedObjects.emplace_back(ObjectReference::read(reader));
             }
 
             return header;
         }
 
+        // Two-phase parse of a contiguous body: a sequential pass only reads the leading size of every object
+        // to build the offset table, then the objects are decoded on threadCount threads (0 = hardware concurrency)
+        // into preallocated slots. The result is identical to read().
+        // With an arena, strings and object payloads are allocated from it and the body keeps it alive.
+        // collectTransforms fills actorTransforms along with the object headers.
+        static SaveFileBody readParallel(const uint8_t* data, int64_t size, unsigned threadCount = 0, std::shared_ptr<Arena> arena = nullptr, bool collectTransforms = false);
+        static SaveFileBody readParallel(const ByteBuffer& data, unsigned threadCount = 0, std::shared_ptr<Arena> arena = nullptr, bool collectTransforms = false) {
+            return readParallel(data.data(), data.size(), threadCount, std::move(arena), collectTransforms);
+        }
+
+        // Skips objectCount objects starting at the reader's position, returns objectCount + 1 offsets
+        // (relative to the reader's start); object i spans [offsets[i], offsets[i + 1]).
+        static std::vector<int64_t> indexObjects(BodyReader& reader, Int objectCount);
+
         void write(std::ostream& stream) const {
             PropertyWriter writer(stream);
             writer.writeBasicType(uncompressedSize);
             writer.writeBasicType(objectHeaderCount);
 
             for (auto& objectHeader : objectHeaders) {
-                if (objectHeader.headerType == 0) {
-                    std::get<ComponentHeader>(objectHeader.header).write(stream);
-                } else {
-                    std::get<ActorHeader>(objectHeader.header).write(stream);
-                }
+                objectHeader.write(stream);
             }
 
             writer.writeBasicType(objectCount);
@@ -327,6 +482,68 @@ namespace factorygame {
                 collectedObject.write(stream);
             }
         }
+
+        // what write() emits, including the leading uncompressedSize field
+        int64_t serializedSize() const {
+            int64_t size = 4 * sizeof(Int);
+            for (auto& objectHeader : objectHeaders) {
+                size += objectHeader.serializedSize();
+            }
+            for (auto& object : objects) {
+                size += object.serializedSize();
+            }
+            for (auto& collectedObject : collectedObjects) {
+                size += collectedObject.serializedSize();
+            }
+            return size;
+        }
+
+        // Serializes the body into one exactly sized buffer, disjoint object ranges are written by threadCount threads
+        // (0 = hardware concurrency). Unlike write(), the leading uncompressedSize is set to the real body size.
+        ByteBuffer serialize(unsigned threadCount = 1) const;
+        // Same bytes as serialize(), produced in windows of about windowSize bytes that are handed to consume in order.
+        // threadCount windows are written at a time, so the whole body is never in memory at once.
+        void serializeWindows(unsigned threadCount, int64_t windowSize, const std::function<void(const uint8_t*, int64_t)>& consume) const;
+    };
+
+    // Lazy view of a save body for header-only tooling: object headers and collected objects are parsed up front,
+    // objects are only indexed (offset and size within the decompressed body, which the view keeps alive)
+    // and decoded on first access.
+    class SaveFileBodyView {
+    public:
+        // collectTransforms fills actorTransforms() along with the object headers
+        explicit SaveFileBodyView(ByteBuffer data, bool collectTransforms = false) : SaveFileBodyView(std::make_shared<const ByteBuffer>(std::move(data)), collectTransforms) {}
+        explicit SaveFileBodyView(std::shared_ptr<const ByteBuffer> data, bool collectTransforms = false);
+
+        Int uncompressedSize() const { return _uncompressedSize; }
+        const std::vector<ObjectHeader>& objectHeaders() const { return _objectHeaders; }
+        const std::vector<ObjectReference>& collectedObjects() const { return _collectedObjects; }
+        const StringTable& strings() const { return *_strings; }
+        const std::optional<ActorTransforms>& actorTransforms() const { return _actorTransforms; }
+        const std::shared_ptr<const ByteBuffer>& data() const { return _data; }
+
+        // number of indexed objects, 0 when the header and object counts of the body differ
+        int64_t objectCount() const { return static_cast<int64_t>(_objectOffsets.size()) - 1; }
+        // serialized object, starting with its size field
+        const uint8_t* objectData(int64_t objIx) const { return _data->data() + _objectOffsets.at(objIx); }
+        int64_t objectSize(int64_t objIx) const { return _objectOffsets.at(objIx + 1) - _objectOffsets[objIx]; }
+
+        // Decodes the object on first access and caches it. Not thread safe, use materialize() for bulk decoding.
+        const Object& object(int64_t objIx) const;
+
+        // Decodes every object on threadCount threads (0 = hardware concurrency), the result is identical to SaveFileBody::read()
+        SaveFileBody materialize(unsigned threadCount = 0) const;
+
+    private:
+        std::shared_ptr<const ByteBuffer> _data;
+        std::shared_ptr<StringTable> _strings;
+        Int _uncompressedSize{};
+        Int _objectCount{};
+        std::vector<ObjectHeader> _objectHeaders;
+        std::vector<int64_t> _objectOffsets;
+        std::vector<ObjectReference> _collectedObjects;
+        std::optional<ActorTransforms> _actorTransforms;
+        mutable std::vector<std::unique_ptr<Object>> _objects; // allocated on the first object() call
     };
 
 
@@ -368,7 +585,22 @@ namespace factorygame {
         const SaveFileHeader& header() const { return _header; }
         const std::vector<CompressedChunkInfo>& chunks() const { return _chunks; }
 
-        static std::vector<uint8_t> decompressChunks(const factorygame::SaveFileLoader& loader, std::istream& fileStream);
+        // threadCount: number of threads inflating chunks (0 = hardware concurrency)
+        static ByteBuffer decompressChunks(const factorygame::SaveFileLoader& loader, std::istream& fileStream, unsigned threadCount = 1);
+        // Inflates straight from the mapped file into the result, without intermediate buffers
+        static ByteBuffer decompressChunks(const factorygame::SaveFileLoader& loader, const MappedFile& file, unsigned threadCount = 1);
+
+        // Receives each object of the body in order, the object is dropped when the call returns
+        using ObjectVisitor = std::function<void(int64_t objIx, const ObjectHeader& header, Object&& object)>;
+
+        // Parses the body while it is being inflated: chunks are decompressed on threadCount threads
+        // (0 = hardware concurrency) at most `window` chunks ahead of the parser, so the inflated body is never
+        // held as a whole. The returned objects still hold almost all of its bytes, which makes the peak about
+        // one uncompressed body instead of two (inflated buffer plus parsed copy).
+        static SaveFileBody readBodyStreaming(const factorygame::SaveFileLoader& loader, const MappedFile& file, unsigned threadCount = 0, int64_t window = 8);
+        // Same parse, but objects are handed to visitObject instead of being kept. The returned body has the object
+        // headers and collected objects only, peak memory is those plus the window and the largest object.
+        static SaveFileBody readBodyStreaming(const factorygame::SaveFileLoader& loader, const MappedFile& file, const ObjectVisitor& visitObject, unsigned threadCount = 0, int64_t window = 8);
 
     private:
         SaveFileHeader _header;
@@ -380,6 +612,32 @@ namespace factorygame {
 
 
     
+    // Output sink for the save body: cuts what is written into chunkSize blocks and hands every full block
+    // to the compressor threads right away. Compressed chunks (header + payload) go to target in order.
+    class ChunkCompressingStreamBuf : public std::streambuf {
+    public:
+        ChunkCompressingStreamBuf(std::ostream& target, int64_t chunkSize, unsigned threadCount, const CompressionProfile& profile);
+
+        // Compresses the last partial block and writes every pending chunk, rethrows compression errors
+        void finish();
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+    private:
+        std::ostream& _target;
+        const int64_t _chunkSize;
+        const CompressionProfile _profile;
+        ThreadPool _pool;
+        const size_t _window;
+        ByteBuffer _block;
+        int64_t _chunkCount = 0;
+        std::deque<std::pair<int64_t, std::future<std::vector<uint8_t>>>> _pending;
+
+        void _submitBlock();
+        void _writeFront();
+    };
+
     class SaveFileWriter {
     public:
         struct CompressedChunk {
@@ -388,43 +646,18 @@ namespace factorygame {
 
         };
 
-        static void save(std::ostream& stream, const SaveFileHeader& header, const SaveFileBody& body) {
-            header.write(stream);
-            std::stringstream uncompressedDataSS; // TODO??, inefficient, stream vs vector
-            body.write(uncompressedDataSS);
-            std::vector<uint8_t> uncompressedData;
-            auto str = uncompressedDataSS.str();
-            uncompressedData.resize(str.size());
-            memcpy(uncompressedData.data(), str.data(), str.size());
-            *reinterpret_cast<int32_t*>(&uncompressedData.data()[0]) = uncompressedData.size() - 4; // fix uncompressed size
-
-            //std::ofstream ofs("uncomprbeforesave.txt", std::ios::binary);
-            //ofs.write((const char*)uncompressedData.data(), uncompressedData.size());
-
-            auto chunks = _compressDataIntoChunks(uncompressedData);
-            for (auto& chunk : chunks) {
-                _writeChunk(stream, chunk);
-            }
-        }
+        static constexpr int64_t chunkSize = 128 * 1024;
+
+        // threadCount: number of threads deflating chunks (0 = hardware concurrency)
+        // profile: deflate settings, e.g. CompressionProfile::fast() for batch re-saves, archive() for level 9
+        // The body is serialized by object range on threadCount threads and fed to a ChunkCompressingStreamBuf,
+        // it never exists uncompressed as a whole
+        static void save(std::ostream& stream, const SaveFileHeader& header, const SaveFileBody& body, unsigned threadCount = 1, const CompressionProfile& profile = {});
 
         static void _writeChunk(std::ostream& stream, const CompressedChunk& chunk) {
             CompressedChunkHeader header = CompressedChunkHeader::create(chunk.data.size(), chunk.uncompressedSize);
             header.write(stream);
             stream.write((const char*)chunk.data.data(), chunk.data.size());
         }
-
-        static std::vector<CompressedChunk> _compressDataIntoChunks(const std::vector<uint8_t>& data) {
-            std::vector<CompressedChunk> chunks;
-            int64_t rem = data.size();
-            constexpr int64_t blockSize = 128 * 1024;
-            const uint8_t* srcPtr = data.data();
-            do {
-                auto size = std::min(blockSize, rem);
-                chunks.emplace_back(CompressedChunk{size, Compressor::compress(srcPtr, size) });
-                srcPtr += size;
-                rem -= size;
-            } while (rem > 0);
-            return chunks;
-        }
     };
 }
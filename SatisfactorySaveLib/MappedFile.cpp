@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace factorygame {
+
+#ifdef _WIN32
+
+    MappedFile::MappedFile(const std::string& filename) {
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error(std::string("Couldn't open file: ") + filename);
+        }
+        _fileHandle = file;
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(file, &fileSize)) {
+            _close();
+            throw std::runtime_error(std::string("Couldn't get file size: ") + filename);
+        }
+        _size = fileSize.QuadPart;
+        if (_size == 0) {
+            return;
+        }
+
+        _mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_mappingHandle) {
+            _close();
+            throw std::runtime_error(std::string("Couldn't map file: ") + filename);
+        }
+        _data = static_cast<const uint8_t*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (!_data) {
+            _close();
+            throw std::runtime_error(std::string("Couldn't map file: ") + filename);
+        }
+    }
+
+    void MappedFile::_close() {
+        if (_data) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mappingHandle) {
+            CloseHandle(_mappingHandle);
+        }
+        if (_fileHandle) {
+            CloseHandle(_fileHandle);
+        }
+        _data = nullptr;
+        _mappingHandle = nullptr;
+        _fileHandle = nullptr;
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::string& filename) {
+        _fd = open(filename.c_str(), O_RDONLY);
+        if (_fd < 0) {
+            throw std::runtime_error(std::string("Couldn't open file: ") + filename);
+        }
+
+        struct stat fileStat {};
+        if (fstat(_fd, &fileStat) != 0) {
+            _close();
+            throw std::runtime_error(std::string("Couldn't get file size: ") + filename);
+        }
+        _size = fileStat.st_size;
+        if (_size == 0) {
+            return;
+        }
+
+        void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (mapping == MAP_FAILED) {
+            _close();
+            throw std::runtime_error(std::string("Couldn't map file: ") + filename);
+        }
+        _data = static_cast<const uint8_t*>(mapping);
+        madvise(mapping, _size, MADV_SEQUENTIAL);
+    }
+
+    void MappedFile::_close() {
+        if (_data) {
+            munmap(const_cast<uint8_t*>(_data), _size);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+        _data = nullptr;
+        _fd = -1;
+    }
+
+#endif
+
+    MappedFile::~MappedFile() {
+        _close();
+    }
+
+}
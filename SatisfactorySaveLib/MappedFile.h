@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace factorygame {
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data() const { return _data; }
+        int64_t size() const { return _size; }
+
+    private:
+        const uint8_t* _data = nullptr;
+        int64_t _size = 0;
+#ifdef _WIN32
+        void* _fileHandle = nullptr;
+        void* _mappingHandle = nullptr;
+#else
+        int _fd = -1;
+#endif
+
+        void _close();
+    };
+
+}
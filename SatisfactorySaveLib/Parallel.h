@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace factorygame {
+
+    inline unsigned defaultThreadCount() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Calls fn(ix) for every ix in [0, count) on up to threadCount threads (0 = hardware concurrency).
+    // Work items are handed out one by one, the first exception thrown by a worker is rethrown here.
+    template<typename Fn>
+    void parallelFor(int64_t count, unsigned threadCount, Fn&& fn) {
+        if (threadCount == 0) {
+            threadCount = defaultThreadCount();
+        }
+        threadCount = static_cast<unsigned>(std::min<int64_t>(threadCount, count));
+        if (threadCount <= 1) {
+            for (int64_t ix = 0; ix < count; ++ix) {
+                fn(ix);
+            }
+            return;
+        }
+
+        std::atomic<int64_t> nextIx{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto worker = [&]() {
+            try {
+                for (int64_t ix = nextIx++; ix < count && !failed; ix = nextIx++) {
+                    fn(ix);
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (unsigned i = 1; i < threadCount; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Produces items [0, count) on threadCount worker threads (0 = hardware concurrency) and hands them out
+    // in index order through next(). At most `window` items are produced ahead of the consumer.
+    template<typename Result>
+    class OrderedProducer {
+    public:
+        OrderedProducer(int64_t count, unsigned threadCount, int64_t window, std::function<Result(int64_t)> produce)
+            : _count(count), _window(std::max<int64_t>(window, 1)), _produce(std::move(produce)), _ring(_window) {
+            if (threadCount == 0) {
+                threadCount = defaultThreadCount();
+            }
+            threadCount = static_cast<unsigned>(std::min<int64_t>(threadCount, count));
+            if (threadCount <= 1) {
+                return; // produced on the consumer thread in next()
+            }
+            _threads.reserve(threadCount);
+            for (unsigned i = 0; i < threadCount; ++i) {
+                _threads.emplace_back([this]() { _work(); });
+            }
+        }
+
+        ~OrderedProducer() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopped = true;
+            }
+            _cv.notify_all();
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        OrderedProducer(const OrderedProducer&) = delete;
+        OrderedProducer& operator=(const OrderedProducer&) = delete;
+
+        // Returns false once all items were consumed, rethrows the first exception thrown by produce
+        bool next(Result& out) {
+            if (_consumedCount >= _count) {
+                return false;
+            }
+            if (_threads.empty()) {
+                out = _produce(_consumedCount++);
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto& slot = _ring[_consumedCount % _window];
+            _cv.wait(lock, [&]() { return _error || slot.has_value(); });
+            if (_error) {
+                std::rethrow_exception(_error);
+            }
+            out = std::move(*slot);
+            slot.reset();
+            ++_consumedCount;
+            lock.unlock();
+            _cv.notify_all();
+            return true;
+        }
+
+    private:
+        const int64_t _count;
+        const int64_t _window;
+        std::function<Result(int64_t)> _produce;
+        std::vector<std::optional<Result>> _ring;
+        std::vector<std::thread> _threads;
+        int64_t _nextIx = 0;
+        int64_t _consumedCount = 0;
+        bool _stopped = false;
+        std::exception_ptr _error;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+
+        void _work() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                _cv.wait(lock, [&]() { return _stopped || _error || _nextIx >= _count || _nextIx < _consumedCount + _window; });
+                if (_stopped || _error || _nextIx >= _count) {
+                    return;
+                }
+                const int64_t ix = _nextIx++;
+                lock.unlock();
+                std::optional<Result> result;
+                std::exception_ptr error;
+                try {
+                    result.emplace(_produce(ix));
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                lock.lock();
+                if (error) {
+                    if (!_error) {
+                        _error = error;
+                    }
+                } else {
+                    _ring[ix % _window] = std::move(result);
+                }
+                _cv.notify_all();
+            }
+        }
+    };
+
+    // Fixed set of worker threads running submitted tasks in FIFO order (0 threads = hardware concurrency).
+    // With a single thread tasks run inline in submit(). Queued tasks are finished before destruction.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned threadCount) {
+            if (threadCount == 0) {
+                threadCount = defaultThreadCount();
+            }
+            if (threadCount <= 1) {
+                return;
+            }
+            _threads.reserve(threadCount);
+            for (unsigned i = 0; i < threadCount; ++i) {
+                _threads.emplace_back([this]() { _work(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopped = true;
+            }
+            _cv.notify_all();
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned threadCount() const { return std::max<unsigned>(1, static_cast<unsigned>(_threads.size())); }
+
+        template<typename Fn>
+        auto submit(Fn&& fn) -> std::future<decltype(fn())> {
+            using Result = decltype(fn());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+            auto future = task->get_future();
+            if (_threads.empty()) {
+                (*task)();
+                return future;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _tasks.emplace([task]() { (*task)(); });
+            }
+            _cv.notify_one();
+            return future;
+        }
+
+    private:
+        std::vector<std::thread> _threads;
+        std::queue<std::function<void()>> _tasks;
+        bool _stopped = false;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+
+        void _work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cv.wait(lock, [&]() { return _stopped || !_tasks.empty(); });
+                    if (_tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(_tasks.front());
+                    _tasks.pop();
+                }
+                task();
+            }
+        }
+    };
+
+}
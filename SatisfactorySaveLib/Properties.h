@@ -1,6 +1,17 @@
 #pragma once
 
+#include "Arena.h"
+#include "Endian.h"
+#include "Utf16.h"
+
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 namespace factorygame {
 
@@ -9,57 +20,230 @@ namespace factorygame {
     using Int = int32_t;
     using Long = int64_t;
     using Float = float;
+    using Double = double;
 
     struct String {
         int32_t size;
-        std::string str;
+        ArenaString str; // UTF-8, also for strings stored as UTF-16
+        bool utf16 = false; // written back as UTF-16
+
+        // bytes PropertyWriter emits: length field, characters, terminator (nothing for empty UTF-8 strings)
+        int64_t serializedSize() const {
+            if (utf16) {
+                return sizeof(int32_t) + 2 * (utf16Length(str) + 1);
+            }
+            return sizeof(int32_t) + (str.empty() ? 0 : str.size() + 1);
+        }
     };
 
-    struct ArrayProperty {
+    // Non-owning String read by BodyReader: views the characters in the body buffer, nothing is allocated.
+    // Only valid while the buffer is, callers that modify a string take an owned copy with toString().
+    struct StringView {
+        int32_t size{}; // serialized length field, in characters
+        std::string_view str; // up to the terminator; the little-endian code units for UTF-16
+        bool utf16 = false;
+
+        // bytes BodyWriter emits for it
+        int64_t serializedSize() const {
+            if (utf16) {
+                return sizeof(int32_t) + str.size() + 2;
+            }
+            return sizeof(int32_t) + (str.empty() ? 0 : str.size() + 1);
+        }
+
+        String toString() const {
+            if (utf16) {
+                String result{ size, {}, true };
+                appendUtf16AsUtf8(reinterpret_cast<const uint8_t*>(str.data()), str.size() / 2, result.str);
+                return result;
+            }
+            return { size, ArenaString(str.data(), str.size()) };
+        }
+    };
 
+    // Bytes inside a decoded object's payload
+    struct ByteView {
+        const uint8_t* data = nullptr;
+        int64_t size = 0;
     };
 
-    struct BoolProperty {
+    enum class PropertyType : uint8_t {
+        Unknown,
+        Array,
+        Bool,
+        Byte,
+        Double,
+        Enum,
+        Float,
+        Int,
+        Int64,
+        Interface,
+        Map,
+        Name,
+        Object,
+        Str,
+        Struct,
+        Text,
+        Int8,
+        UInt32,
+        UInt64,
+        Set,
+        SoftObject
+    };
+
+    // Scalar array elements in place in the payload. Elements are loaded through memcpy, so the payload doesn't
+    // have to be aligned, and copyTo() moves the whole array with a single memcpy.
+    template<typename T>
+    class ScalarArrayView {
+    public:
+        ScalarArrayView() = default;
+        ScalarArrayView(const uint8_t* data, int64_t count) : _data(data), _count(count) {}
+
+        int64_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        const uint8_t* data() const { return _data; }
+
+        T operator[](int64_t ix) const {
+            T value;
+            memcpy(&value, _data + ix * sizeof(T), sizeof(T));
+            return littleEndian(value);
+        }
+
+        void copyTo(T* out) const {
+            memcpy(out, _data, _count * sizeof(T));
+            littleEndianInPlace<T>(out, _count);
+        }
+
+        std::vector<T> toVector() const {
+            std::vector<T> result(_count);
+            copyTo(result.data());
+            return result;
+        }
+
+    private:
+        const uint8_t* _data = nullptr;
+        int64_t _count = 0;
+    };
+
+    // Property values produced by PropertyDecoder. Strings and opaque values view the object payload they were
+    // decoded from, the payload has to outlive them.
+
+    // Elements follow the count in data, encoded as innerType
+    struct ArrayProperty {
+        StringView innerType;
+        Int count{};
+        ByteView data;
+        PropertyType elementType = PropertyType::Unknown; // innerType resolved by PropertyDecoder
+
+        // Typed access to arrays of Int, Int64, Float, Double, UInt32, UInt64, Int8, Byte or Bool elements.
+        // Throws when T doesn't match the element type or data isn't count elements of it (e.g. enum name bytes).
+        template<typename T>
+        ScalarArrayView<T> values() const {
+            if (!_holds<T>(elementType)) {
+                throw std::runtime_error("Array of " + std::string(innerType.str) + " doesn't hold elements of the requested type");
+            }
+            if (count < 0 || data.size != static_cast<int64_t>(count) * static_cast<int64_t>(sizeof(T))) {
+                throw std::runtime_error("Array of " + std::string(innerType.str) + " is not a packed scalar array");
+            }
+            return { data.data, count };
+        }
+
+    private:
+        template<typename T>
+        static constexpr bool _holds(PropertyType type) {
+            if constexpr (std::is_same_v<T, Int>) {
+                return type == PropertyType::Int;
+            } else if constexpr (std::is_same_v<T, Long>) {
+                return type == PropertyType::Int64;
+            } else if constexpr (std::is_same_v<T, Float>) {
+                return type == PropertyType::Float;
+            } else if constexpr (std::is_same_v<T, Double>) {
+                return type == PropertyType::Double;
+            } else if constexpr (std::is_same_v<T, uint32_t>) {
+                return type == PropertyType::UInt32;
+            } else if constexpr (std::is_same_v<T, uint64_t>) {
+                return type == PropertyType::UInt64;
+            } else if constexpr (std::is_same_v<T, Byte> || std::is_same_v<T, uint8_t>) {
+                return type == PropertyType::Byte || type == PropertyType::Int8 || type == PropertyType::Bool;
+            } else {
+                return false;
+            }
+        }
+    };
 
+    struct BoolProperty {
+        bool value{};
     };
 
+    // A plain byte when enumName is "None", an enumerator name otherwise
     struct ByteProperty {
+        StringView enumName;
+        Byte value{};
+        StringView enumValue;
+    };
 
+    struct DoubleProperty {
+        Double value{};
     };
 
     struct EnumProperty {
-
+        StringView enumName;
+        StringView value;
     };
 
     struct FloatProperty {
-
+        Float value{};
     };
 
     struct IntProperty {
-
+        Int value{};
     };
 
     struct Int64Property {
-
+        Long value{};
     };
 
     struct MapProperty {
-
+        StringView keyType;
+        StringView valueType;
+        ByteView data;
     };
 
     struct NameProperty {
-
+        StringView value;
     };
 
+    // also used for InterfaceProperty, same encoding
     struct ObjectProperty {
-
+        StringView levelName;
+        StringView pathName;
     };
 
     struct StrProperty {
+        StringView value;
+    };
 
+    // data is a native struct (Vector, Quat, LinearColor...) or a nested property list, depending on structType
+    struct StructProperty {
+        StringView structType;
+        ByteView data;
     };
 
     struct TextProperty {
+        ByteView data;
+    };
+
+    // types without a typed decoder (SetProperty, SoftObjectProperty...), the value is kept as is
+    struct RawProperty {
+        StringView typeName;
+        ByteView data;
+    };
 
+    struct Property {
+        StringView name;
+        PropertyType type = PropertyType::Unknown;
+        Int index{}; // array index of the property
+        std::variant<RawProperty, ArrayProperty, BoolProperty, ByteProperty, DoubleProperty, EnumProperty, FloatProperty, IntProperty,
+            Int64Property, MapProperty, NameProperty, ObjectProperty, StrProperty, StructProperty, TextProperty> value;
     };
 }
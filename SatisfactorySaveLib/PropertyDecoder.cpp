@@ -0,0 +1,265 @@
+#include "PropertyDecoder.h"
+
+#include "Parallel.h"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace factorygame {
+
+    uint32_t PropertyDecoder::_typeKey(std::string_view typeName) {
+        static constexpr size_t suffixSize = 8; // "Property"
+        if (typeName.size() <= suffixSize) {
+            return 0;
+        }
+        return static_cast<uint32_t>(typeName.size()) << 16 | static_cast<uint8_t>(typeName[0]) << 8
+            | static_cast<uint8_t>(typeName[typeName.size() - suffixSize - 1]);
+    }
+
+    PropertyType PropertyDecoder::typeFromName(std::string_view typeName) {
+        // the known names differ in length, first character or the character before "Property", so the lookup
+        // hashes that integer key and confirms the match with one compare
+        static const std::unordered_map<uint32_t, PropertyType> types = [] {
+            std::unordered_map<uint32_t, PropertyType> result;
+            for (int type = static_cast<int>(PropertyType::Unknown) + 1; type <= static_cast<int>(PropertyType::SoftObject); ++type) {
+                const auto name = PropertyDecoder::typeName(static_cast<PropertyType>(type));
+                if (!result.emplace(_typeKey(name), static_cast<PropertyType>(type)).second) {
+                    // a new type name has to differ from the others in the key, or _typeKey has to look at more characters
+                    throw std::runtime_error("Property type key collision for " + std::string(name));
+                }
+            }
+            return result;
+        }();
+        auto it = types.find(_typeKey(typeName));
+        if (it == types.end() || PropertyDecoder::typeName(it->second) != typeName) {
+            return PropertyType::Unknown;
+        }
+        return it->second;
+    }
+
+    std::string_view PropertyDecoder::typeName(PropertyType type) {
+        switch (type) {
+        case PropertyType::Array: return "ArrayProperty";
+        case PropertyType::Bool: return "BoolProperty";
+        case PropertyType::Byte: return "ByteProperty";
+        case PropertyType::Double: return "DoubleProperty";
+        case PropertyType::Enum: return "EnumProperty";
+        case PropertyType::Float: return "FloatProperty";
+        case PropertyType::Int: return "IntProperty";
+        case PropertyType::Int64: return "Int64Property";
+        case PropertyType::Interface: return "InterfaceProperty";
+        case PropertyType::Map: return "MapProperty";
+        case PropertyType::Name: return "NameProperty";
+        case PropertyType::Object: return "ObjectProperty";
+        case PropertyType::Str: return "StrProperty";
+        case PropertyType::Struct: return "StructProperty";
+        case PropertyType::Text: return "TextProperty";
+        case PropertyType::Int8: return "Int8Property";
+        case PropertyType::UInt32: return "UInt32Property";
+        case PropertyType::UInt64: return "UInt64Property";
+        case PropertyType::Set: return "SetProperty";
+        case PropertyType::SoftObject: return "SoftObjectProperty";
+        default: return "Unknown";
+        }
+    }
+
+    void PropertyDecoder::decodeList(BodyReader& reader, std::vector<Property>& properties, const PropertyFilter* filter) {
+        static constexpr int64_t guidSize = 16;
+        // most objects have a handful of properties, skip the first reallocations
+        if (!filter) {
+            properties.reserve(properties.size() + 8);
+        }
+        for (;;) {
+            const StringView name = reader.readBasicType<StringView>();
+            if (name.str == "None") {
+                return;
+            }
+            const StringView typeName = reader.readBasicType<StringView>();
+            const PropertyType type = typeFromName(typeName.str);
+            const Int size = reader.readBasicType<Int>();
+            const Int index = reader.readBasicType<Int>();
+
+            // the tag carries a few type dependent fields before the value
+            StringView typeArg1;
+            StringView typeArg2;
+            Byte boolValue = 0;
+            switch (type) {
+            case PropertyType::Struct:
+                typeArg1 = reader.readBasicType<StringView>();
+                reader.skip(guidSize);
+                break;
+            case PropertyType::Bool:
+                boolValue = reader.readBasicType<Byte>();
+                break;
+            case PropertyType::Byte:
+            case PropertyType::Enum:
+            case PropertyType::Array:
+            case PropertyType::Set:
+                typeArg1 = reader.readBasicType<StringView>();
+                break;
+            case PropertyType::Map:
+                typeArg1 = reader.readBasicType<StringView>();
+                typeArg2 = reader.readBasicType<StringView>();
+                break;
+            default:
+                break;
+            }
+            if (reader.readBasicType<Byte>()) {
+                reader.skip(guidSize); // property guid
+            }
+
+            // the value is decoded from its own range, so a misread value never shifts the rest of the list
+            const uint8_t* value = reader.current();
+            reader.skip(size);
+            if (filter && !filter->wantsName(name.str)) {
+                continue;
+            }
+            Property property;
+            property.name = name;
+            property.type = type;
+            property.index = index;
+            BodyReader valueReader(value, size);
+            _decodeValue(valueReader, property, typeName, typeArg1, typeArg2, boolValue);
+            properties.push_back(std::move(property));
+        }
+    }
+
+    void PropertyDecoder::_decodeValue(BodyReader& reader, Property& property, const StringView& typeName, const StringView& typeArg1, const StringView& typeArg2, Byte boolValue) {
+        switch (property.type) {
+        case PropertyType::Array: {
+            ArrayProperty value{ typeArg1 };
+            value.elementType = typeFromName(typeArg1.str);
+            value.count = reader.readBasicType<Int>();
+            value.data = _rest(reader);
+            property.value = value;
+            break;
+        }
+        case PropertyType::Bool:
+            property.value = BoolProperty{ boolValue != 0 };
+            break;
+        case PropertyType::Byte:
+            if (typeArg1.str == "None") {
+                property.value = ByteProperty{ typeArg1, reader.readBasicType<Byte>() };
+            } else {
+                property.value = ByteProperty{ typeArg1, 0, reader.readBasicType<StringView>() };
+            }
+            break;
+        case PropertyType::Double:
+            property.value = DoubleProperty{ reader.readBasicType<Double>() };
+            break;
+        case PropertyType::Enum:
+            property.value = EnumProperty{ typeArg1, reader.readBasicType<StringView>() };
+            break;
+        case PropertyType::Float:
+            property.value = FloatProperty{ reader.readBasicType<Float>() };
+            break;
+        case PropertyType::Int:
+            property.value = IntProperty{ reader.readBasicType<Int>() };
+            break;
+        case PropertyType::Int64:
+            property.value = Int64Property{ reader.readBasicType<Long>() };
+            break;
+        case PropertyType::Interface:
+        case PropertyType::Object: {
+            ObjectProperty value;
+            value.levelName = reader.readBasicType<StringView>();
+            value.pathName = reader.readBasicType<StringView>();
+            property.value = value;
+            break;
+        }
+        case PropertyType::Map:
+            property.value = MapProperty{ typeArg1, typeArg2, _rest(reader) };
+            break;
+        case PropertyType::Name:
+            property.value = NameProperty{ reader.readBasicType<StringView>() };
+            break;
+        case PropertyType::Str:
+            property.value = StrProperty{ reader.readBasicType<StringView>() };
+            break;
+        case PropertyType::Struct:
+            property.value = StructProperty{ typeArg1, _rest(reader) };
+            break;
+        case PropertyType::Text:
+            property.value = TextProperty{ _rest(reader) };
+            break;
+        default:
+            property.value = RawProperty{ typeName, _rest(reader) };
+            break;
+        }
+    }
+
+    std::vector<Property> PropertyDecoder::decodeList(const ByteView& data, const PropertyFilter* filter) {
+        BodyReader reader(data.data, data.size);
+        std::vector<Property> properties;
+        decodeList(reader, properties, filter);
+        return properties;
+    }
+
+    DecodedObject PropertyDecoder::decode(const ActorObjectRaw& object, const PropertyFilter* filter) {
+        DecodedObject result;
+        BodyReader reader(object.raw.data(), object.raw.size());
+        result.components.reserve(object.componentCount);
+        for (Int componentIx = 0; componentIx < object.componentCount; ++componentIx) {
+            ObjectProperty component;
+            component.levelName = reader.readBasicType<StringView>();
+            component.pathName = reader.readBasicType<StringView>();
+            result.components.push_back(component);
+        }
+        decodeList(reader, result.properties, filter);
+        result.trailing = _rest(reader);
+        return result;
+    }
+
+    DecodedObject PropertyDecoder::decode(const ComponentObjectRaw& object, const PropertyFilter* filter) {
+        DecodedObject result;
+        BodyReader reader(object.raw.data(), object.raw.size());
+        decodeList(reader, result.properties, filter);
+        result.trailing = _rest(reader);
+        return result;
+    }
+
+    DecodedObject PropertyDecoder::decode(const Object& object, const PropertyFilter* filter) {
+        if (object.type == ObjectType::Component) {
+            return decode(std::get<ComponentObjectRaw>(object.object), filter);
+        }
+        return decode(std::get<ActorObjectRaw>(object.object), filter);
+    }
+
+    std::vector<DecodedObject> PropertyDecoder::decode(const SaveFileBody& body, unsigned threadCount) {
+        std::vector<DecodedObject> result(body.objects.size());
+        parallelFor(body.objects.size(), threadCount, [&](int64_t objIx) {
+            result[objIx] = decode(body.objects[objIx]);
+        });
+        return result;
+    }
+
+    std::vector<DecodedObject> PropertyDecoder::decode(const SaveFileBody& body, const PropertyFilter& filter, unsigned threadCount) {
+        // type paths are interned, so the filter is asked once per distinct type path id
+        std::vector<int8_t> wantedTypeIds;
+        std::vector<uint8_t> wanted(body.objects.size(), 1);
+        for (size_t objIx = 0; objIx < body.objects.size() && objIx < body.objectHeaders.size(); ++objIx) {
+            auto& header = body.objectHeaders[objIx];
+            const InternedString& typePath = header.headerType == 0
+                ? std::get<ComponentHeader>(header.header).typePath
+                : std::get<ActorHeader>(header.header).typePath;
+            if (typePath.id() >= wantedTypeIds.size()) {
+                wantedTypeIds.resize(typePath.id() + 1, -1);
+            }
+            auto& decision = wantedTypeIds[typePath.id()];
+            if (decision < 0) {
+                decision = filter.wantsTypePath(typePath.str());
+            }
+            wanted[objIx] = decision;
+        }
+
+        std::vector<DecodedObject> result(body.objects.size());
+        parallelFor(body.objects.size(), threadCount, [&](int64_t objIx) {
+            if (wanted[objIx]) {
+                result[objIx] = decode(body.objects[objIx], &filter);
+            }
+        });
+        return result;
+    }
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FactoryGameSave.h"
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace factorygame {
+
+    // Typed view of an object's raw payload. Everything in it points into the payload (ActorObjectRaw::raw,
+    // ComponentObjectRaw::raw), which has to outlive it.
+    struct DecodedObject {
+        std::vector<ObjectProperty> components; // actors only: references to their components
+        std::vector<Property> properties;
+        ByteView trailing; // object specific data after the property list
+    };
+
+    // Property names and object type paths to decode, an empty set matches everything
+    class PropertyFilter {
+    public:
+        PropertyFilter() = default;
+        explicit PropertyFilter(std::vector<std::string> names, std::vector<std::string> typePaths = {}) {
+            for (auto& name : names) {
+                addName(std::move(name));
+            }
+            for (auto& typePath : typePaths) {
+                addTypePath(std::move(typePath));
+            }
+        }
+
+        void addName(std::string name) {
+            _nameLengths |= _lengthBit(name.size());
+            _names.insert(_store(std::move(name)));
+        }
+        void addTypePath(std::string typePath) { _typePaths.insert(_store(std::move(typePath))); }
+
+        // most unwanted names are turned down by their length, without hashing them
+        bool wantsName(std::string_view name) const {
+            return _names.empty() || ((_nameLengths & _lengthBit(name.size())) && _names.count(name));
+        }
+        bool wantsTypePath(std::string_view typePath) const { return _typePaths.empty() || _typePaths.count(typePath); }
+
+    private:
+        std::deque<std::string> _strings; // the sets view these, deque elements never move
+        std::unordered_set<std::string_view> _names;
+        std::unordered_set<std::string_view> _typePaths;
+        uint64_t _nameLengths = 0; // bit n: a wanted name has length n (bit 63: 63 or more)
+
+        static uint64_t _lengthBit(size_t length) { return uint64_t(1) << std::min<size_t>(length, 63); }
+
+        std::string_view _store(std::string str) { return _strings.emplace_back(std::move(str)); }
+    };
+
+    // Decodes the tagged property lists of object payloads. Type names are resolved once per property
+    // to a PropertyType through a fixed table, values are then decoded by a switch over that type.
+    class PropertyDecoder {
+    public:
+        static PropertyType typeFromName(std::string_view typeName);
+        static std::string_view typeName(PropertyType type);
+
+        // Reads properties up to and including the "None" terminator. With a filter, properties of other names
+        // are stepped over by their size field, only their tag is read.
+        static void decodeList(BodyReader& reader, std::vector<Property>& properties, const PropertyFilter* filter = nullptr);
+        // Decodes the property list of a struct value that is not a native struct
+        static std::vector<Property> decodeList(const ByteView& data, const PropertyFilter* filter = nullptr);
+
+        static DecodedObject decode(const ActorObjectRaw& object, const PropertyFilter* filter = nullptr);
+        static DecodedObject decode(const ComponentObjectRaw& object, const PropertyFilter* filter = nullptr);
+        static DecodedObject decode(const Object& object, const PropertyFilter* filter = nullptr);
+
+        // Decodes every object of the body on threadCount threads (0 = hardware concurrency), in object order
+        static std::vector<DecodedObject> decode(const SaveFileBody& body, unsigned threadCount = 0);
+        // Objects whose type path the filter doesn't want are left empty without reading their payload
+        static std::vector<DecodedObject> decode(const SaveFileBody& body, const PropertyFilter& filter, unsigned threadCount = 0);
+
+    private:
+        static uint32_t _typeKey(std::string_view typeName);
+        // typeArg1/typeArg2: struct, enum, inner or key/value type names from the tag, boolValue: BoolProperty's value
+        static void _decodeValue(BodyReader& reader, Property& property, const StringView& typeName, const StringView& typeArg1, const StringView& typeArg2, Byte boolValue);
+        static ByteView _rest(const BodyReader& reader) { return { reader.current(), reader.remaining() }; }
+    };
+
+}
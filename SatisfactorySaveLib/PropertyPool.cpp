@@ -0,0 +1,264 @@
+#include "PropertyPool.h"
+
+#include "Endian.h"
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+namespace factorygame {
+
+    PropertyPoolView::PropertyPoolView(const PropertyPoolObject* objects, uint32_t objectCount, const PropertyNode* nodes, uint32_t nodeCount,
+        const PropertyPoolString* strings, uint32_t stringCount, const char* stringData, uint64_t stringDataSize, const uint8_t* data, uint64_t dataSize)
+        : _objects(objects), _objectCount(objectCount), _nodes(nodes), _nodeCount(nodeCount), _strings(strings), _stringCount(stringCount),
+        _stringData(stringData), _stringDataSize(stringDataSize), _data(data), _dataSize(dataSize) {
+    }
+
+    static uint64_t paddedSize(uint64_t size) {
+        return (size + 7) & ~uint64_t(7);
+    }
+
+    PropertyPoolView PropertyPoolView::fromMemory(const uint8_t* memory, int64_t size) {
+        if (hostIsBigEndian) {
+            throw std::runtime_error("Property pools can only be mapped on little-endian hosts");
+        }
+        if (reinterpret_cast<uintptr_t>(memory) % 8 != 0) {
+            throw std::runtime_error("Property pool memory is not 8-byte aligned");
+        }
+        if (size < static_cast<int64_t>(sizeof(PropertyPoolHeader))) {
+            throw std::runtime_error("Property pool is truncated");
+        }
+        const auto& header = *reinterpret_cast<const PropertyPoolHeader*>(memory);
+        if (header.magicValue != PropertyPoolHeader::magic) {
+            throw std::runtime_error("Not a property pool");
+        }
+        if (header.version != PropertyPoolHeader::currentVersion) {
+            throw std::runtime_error("Unsupported property pool version " + std::to_string(header.version));
+        }
+
+        // section sizes are bounded by the 32-bit counts, only the byte sections need an overflow check
+        const uint64_t available = static_cast<uint64_t>(size);
+        if (header.stringDataSize > available || header.dataSize > available) {
+            throw std::runtime_error("Property pool is truncated");
+        }
+        uint64_t offset = sizeof(PropertyPoolHeader);
+        const uint64_t objectsOffset = offset;
+        offset += paddedSize(uint64_t(header.objectCount) * sizeof(PropertyPoolObject));
+        const uint64_t nodesOffset = offset;
+        offset += paddedSize(uint64_t(header.nodeCount) * sizeof(PropertyNode));
+        const uint64_t stringsOffset = offset;
+        offset += paddedSize(uint64_t(header.stringCount) * sizeof(PropertyPoolString));
+        const uint64_t stringDataOffset = offset;
+        offset += paddedSize(header.stringDataSize);
+        const uint64_t dataOffset = offset;
+        if (dataOffset + header.dataSize > available) {
+            throw std::runtime_error("Property pool is truncated");
+        }
+
+        PropertyPoolView view(reinterpret_cast<const PropertyPoolObject*>(memory + objectsOffset), header.objectCount,
+            reinterpret_cast<const PropertyNode*>(memory + nodesOffset), header.nodeCount,
+            reinterpret_cast<const PropertyPoolString*>(memory + stringsOffset), header.stringCount,
+            reinterpret_cast<const char*>(memory + stringDataOffset), header.stringDataSize, memory + dataOffset, header.dataSize);
+
+        // check the references once so the accessors can trust them
+        for (uint32_t objIx = 0; objIx < view._objectCount; ++objIx) {
+            const auto& object = view._objects[objIx];
+            if (uint64_t(object.firstNode) + object.nodeCount > view._nodeCount || uint64_t(object.trailing.offset) + object.trailing.size > view._dataSize) {
+                throw std::runtime_error("Property pool object " + std::to_string(objIx) + " is out of bounds");
+            }
+        }
+        for (uint32_t id = 0; id < view._stringCount; ++id) {
+            const auto& entry = view._strings[id];
+            if (uint64_t(entry.offset) + entry.size > view._stringDataSize) {
+                throw std::runtime_error("Property pool string " + std::to_string(id) + " is out of bounds");
+            }
+        }
+        return view;
+    }
+
+    const PropertyPoolObject& PropertyPoolView::object(uint32_t objIx) const {
+        if (objIx >= _objectCount) {
+            throw std::out_of_range("Property pool object index out of range");
+        }
+        return _objects[objIx];
+    }
+
+    const PropertyNode& PropertyPoolView::node(uint32_t nodeIx) const {
+        if (nodeIx >= _nodeCount) {
+            throw std::out_of_range("Property pool node index out of range");
+        }
+        return _nodes[nodeIx];
+    }
+
+    const PropertyPoolString& PropertyPoolView::_stringEntry(uint32_t id) const {
+        if (id >= _stringCount) {
+            throw std::out_of_range("Property pool string id out of range");
+        }
+        return _strings[id];
+    }
+
+    std::string_view PropertyPoolView::string(uint32_t id) const {
+        const auto& entry = _stringEntry(id);
+        return { _stringData + entry.offset, entry.size };
+    }
+
+    ByteView PropertyPoolView::bytes(const PropertyRef& ref) const {
+        if (uint64_t(ref.offset) + ref.size > _dataSize) {
+            throw std::out_of_range("Property pool data reference out of range");
+        }
+        return { _data + ref.offset, ref.size };
+    }
+
+    static void writeSection(std::ostream& stream, const void* data, uint64_t size) {
+        static const char padding[8] = {};
+        stream.write(static_cast<const char*>(data), size);
+        stream.write(padding, paddedSize(size) - size);
+    }
+
+    void PropertyPoolView::write(std::ostream& stream) const {
+        if (hostIsBigEndian) {
+            throw std::runtime_error("Property pools can only be written on little-endian hosts");
+        }
+        PropertyPoolHeader header{};
+        header.magicValue = PropertyPoolHeader::magic;
+        header.version = PropertyPoolHeader::currentVersion;
+        header.objectCount = _objectCount;
+        header.nodeCount = _nodeCount;
+        header.stringCount = _stringCount;
+        header.stringDataSize = _stringDataSize;
+        header.dataSize = _dataSize;
+        writeSection(stream, &header, sizeof(header));
+        writeSection(stream, _objects, uint64_t(_objectCount) * sizeof(PropertyPoolObject));
+        writeSection(stream, _nodes, uint64_t(_nodeCount) * sizeof(PropertyNode));
+        writeSection(stream, _strings, uint64_t(_stringCount) * sizeof(PropertyPoolString));
+        writeSection(stream, _stringData, _stringDataSize);
+        writeSection(stream, _data, _dataSize);
+    }
+
+    PropertyPool::PropertyPool() : _strings(1, PropertyPoolString{}), _table(std::make_unique<StringTable>()) {
+    }
+
+    uint32_t PropertyPool::_string(const StringView& str) {
+        InternedString interned;
+        if (str.utf16) {
+            const String decoded = str.toString();
+            interned = _table->intern(std::string_view(decoded.str.data(), decoded.str.size()), str.size, true);
+        } else {
+            interned = _table->intern(str.str, str.size);
+        }
+        const uint32_t id = interned.id();
+        if (id == _strings.size()) {
+            // first occurrence, the table hands out consecutive ids
+            const auto& chars = interned.str();
+            if (_stringData.size() + chars.size() > std::numeric_limits<uint32_t>::max()) {
+                throw std::runtime_error("Property pool string data exceeds 4 GiB");
+            }
+            _strings.push_back({ static_cast<uint32_t>(_stringData.size()), static_cast<uint32_t>(chars.size()), static_cast<uint8_t>(str.utf16) });
+            _stringData.insert(_stringData.end(), chars.begin(), chars.end());
+        }
+        return id;
+    }
+
+    PropertyRef PropertyPool::_bytes(const ByteView& bytes) {
+        if (_data.size() + bytes.size > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Property pool data exceeds 4 GiB");
+        }
+        PropertyRef ref{ static_cast<uint32_t>(_data.size()), static_cast<uint32_t>(bytes.size) };
+        _data.insert(_data.end(), bytes.data, bytes.data + bytes.size);
+        return ref;
+    }
+
+    PropertyNode PropertyPool::_node(const Property& property) {
+        PropertyNode node{};
+        node.name = _string(property.name);
+        node.index = property.index;
+        node.type = property.type;
+        std::visit([&](const auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, ArrayProperty>) {
+                node.typeArg = _string(value.innerType);
+                node.aux = static_cast<uint32_t>(value.count);
+                node.value.ref = _bytes(value.data);
+            } else if constexpr (std::is_same_v<T, BoolProperty>) {
+                node.value.i32 = value.value ? 1 : 0;
+            } else if constexpr (std::is_same_v<T, ByteProperty>) {
+                node.typeArg = _string(value.enumName);
+                if (value.enumName.str == "None") {
+                    node.value.i32 = value.value;
+                } else {
+                    node.flags = PropertyNode::EnumValue;
+                    node.value.strings[0] = _string(value.enumValue);
+                }
+            } else if constexpr (std::is_same_v<T, DoubleProperty>) {
+                node.value.f64 = value.value;
+            } else if constexpr (std::is_same_v<T, EnumProperty>) {
+                node.typeArg = _string(value.enumName);
+                node.value.strings[0] = _string(value.value);
+            } else if constexpr (std::is_same_v<T, FloatProperty>) {
+                node.value.f32 = value.value;
+            } else if constexpr (std::is_same_v<T, IntProperty>) {
+                node.value.i32 = value.value;
+            } else if constexpr (std::is_same_v<T, Int64Property>) {
+                node.value.i64 = value.value;
+            } else if constexpr (std::is_same_v<T, MapProperty>) {
+                node.typeArg = _string(value.keyType);
+                node.aux = _string(value.valueType);
+                node.value.ref = _bytes(value.data);
+            } else if constexpr (std::is_same_v<T, NameProperty> || std::is_same_v<T, StrProperty>) {
+                node.value.strings[0] = _string(value.value);
+            } else if constexpr (std::is_same_v<T, ObjectProperty>) {
+                node.value.strings[0] = _string(value.levelName);
+                node.value.strings[1] = _string(value.pathName);
+            } else if constexpr (std::is_same_v<T, StructProperty>) {
+                node.typeArg = _string(value.structType);
+                node.value.ref = _bytes(value.data);
+            } else if constexpr (std::is_same_v<T, TextProperty>) {
+                node.value.ref = _bytes(value.data);
+            } else {
+                node.typeArg = _string(value.typeName);
+                node.value.ref = _bytes(value.data);
+            }
+        }, property.value);
+        return node;
+    }
+
+    uint32_t PropertyPool::add(const DecodedObject& object) {
+        if (_nodes.size() + object.properties.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Property pool exceeds 2^32 nodes");
+        }
+        PropertyPoolObject entry{ static_cast<uint32_t>(_nodes.size()), static_cast<uint32_t>(object.properties.size()) };
+        for (const auto& property : object.properties) {
+            _nodes.push_back(_node(property));
+        }
+        entry.trailing = _bytes(object.trailing);
+        _objects.push_back(entry);
+        return static_cast<uint32_t>(_objects.size() - 1);
+    }
+
+    PropertyPool PropertyPool::build(const std::vector<DecodedObject>& objects) {
+        PropertyPool pool;
+        size_t propertyCount = 0;
+        for (const auto& object : objects) {
+            propertyCount += object.properties.size();
+        }
+        pool._objects.reserve(objects.size());
+        pool._nodes.reserve(propertyCount);
+        for (const auto& object : objects) {
+            pool.add(object);
+        }
+        return pool;
+    }
+
+    PropertyPoolView PropertyPool::view() const {
+        return PropertyPoolView(_objects.data(), static_cast<uint32_t>(_objects.size()), _nodes.data(), static_cast<uint32_t>(_nodes.size()),
+            _strings.data(), static_cast<uint32_t>(_strings.size()), _stringData.data(), _stringData.size(), _data.data(), _data.size());
+    }
+
+    size_t PropertyPool::memoryUsage() const {
+        return _objects.capacity() * sizeof(PropertyPoolObject) + _nodes.capacity() * sizeof(PropertyNode)
+            + _strings.capacity() * sizeof(PropertyPoolString) + _stringData.capacity() + _data.capacity();
+    }
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "PropertyDecoder.h"
+#include "StringTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace factorygame {
+
+    // Compact storage for decoded properties: one fixed-size node per property with scalars inline, strings and
+    // opaque values referenced by id or offset into the pool's own sections, no pointers anywhere.
+    //
+    // Stable layout (version 1). Everything is little-endian, a written pool is this header followed by the
+    // sections in order, each starting at a multiple of 8 bytes:
+    //   header      PropertyPoolHeader, 48 bytes
+    //   objects     objectCount x PropertyPoolObject (16 bytes)
+    //   nodes       nodeCount x PropertyNode (32 bytes)
+    //   strings     stringCount x PropertyPoolString (12 bytes), string id = index, id 0 is the empty string
+    //   stringData  stringDataSize bytes of UTF-8 (strings stored as UTF-16 in the save are flagged)
+    //   data        dataSize bytes of opaque values (array elements, struct, map and text payloads...)
+    // Fields marked reserved are written as 0. New fields only go into reserved space, anything else bumps the version.
+
+    struct PropertyRef {
+        uint32_t offset; // into the data section
+        uint32_t size;
+    };
+
+    struct PropertyNode {
+        enum Flags : uint8_t {
+            EnumValue = 1 // ByteProperty holding an enumerator name (value.strings[0]) instead of a byte (value.i32)
+        };
+
+        uint32_t name; // string id
+        int32_t index; // array index of the property
+        uint32_t typeArg; // string id: struct type, enum name, array inner type, map key type or the name of an unknown type
+        uint32_t aux; // MapProperty: value type string id, ArrayProperty: element count
+        PropertyType type;
+        uint8_t flags;
+        uint8_t reserved[6];
+        union {
+            Int i32; // Int, Bool (0/1), plain Byte
+            Long i64;
+            Float f32;
+            Double f64;
+            uint32_t strings[2]; // Name, Str, Enum and enum Byte: [0], Object and Interface: level name, path name
+            PropertyRef ref; // Array, Map, Struct, Text and types without a typed decoder
+        } value;
+    };
+
+    struct PropertyPoolObject {
+        uint32_t firstNode;
+        uint32_t nodeCount;
+        PropertyRef trailing; // object specific data after the property list
+    };
+
+    struct PropertyPoolString {
+        uint32_t offset; // into the string data section
+        uint32_t size;
+        uint8_t utf16; // written back as UTF-16
+        uint8_t reserved[3];
+    };
+
+    struct PropertyPoolHeader {
+        static constexpr uint32_t magic = 0x4C505053; // "SPPL"
+        static constexpr uint32_t currentVersion = 1;
+
+        uint32_t magicValue;
+        uint32_t version;
+        uint32_t objectCount;
+        uint32_t nodeCount;
+        uint32_t stringCount;
+        uint32_t reserved0;
+        uint64_t stringDataSize;
+        uint64_t dataSize;
+        uint64_t reserved1;
+    };
+
+    static_assert(sizeof(PropertyRef) == 8, "PropertyRef layout is part of the pool format");
+    static_assert(sizeof(PropertyNode) == 32 && offsetof(PropertyNode, type) == 16 && offsetof(PropertyNode, value) == 24, "PropertyNode layout is part of the pool format");
+    static_assert(sizeof(PropertyPoolObject) == 16, "PropertyPoolObject layout is part of the pool format");
+    static_assert(sizeof(PropertyPoolString) == 12, "PropertyPoolString layout is part of the pool format");
+    static_assert(sizeof(PropertyPoolHeader) == 48, "PropertyPoolHeader layout is part of the pool format");
+
+    // Read access to pool sections, either of a PropertyPool or of a written pool in memory (e.g. a MappedFile)
+    class PropertyPoolView {
+    public:
+        PropertyPoolView() = default;
+        PropertyPoolView(const PropertyPoolObject* objects, uint32_t objectCount, const PropertyNode* nodes, uint32_t nodeCount,
+            const PropertyPoolString* strings, uint32_t stringCount, const char* stringData, uint64_t stringDataSize, const uint8_t* data, uint64_t dataSize);
+
+        // Validates the header and section bounds of a written pool, the memory must outlive the view.
+        // Needs a little-endian host and 8-byte aligned memory.
+        static PropertyPoolView fromMemory(const uint8_t* memory, int64_t size);
+
+        uint32_t objectCount() const { return _objectCount; }
+        uint32_t nodeCount() const { return _nodeCount; }
+        uint32_t stringCount() const { return _stringCount; }
+
+        const PropertyPoolObject& object(uint32_t objIx) const;
+        // the nodes of an object are consecutive
+        const PropertyNode* nodes(const PropertyPoolObject& object) const { return _nodes + object.firstNode; }
+        const PropertyNode& node(uint32_t nodeIx) const;
+
+        std::string_view string(uint32_t id) const;
+        bool isUtf16(uint32_t id) const { return _stringEntry(id).utf16 != 0; }
+        ByteView bytes(const PropertyRef& ref) const;
+
+        void write(std::ostream& stream) const;
+
+    private:
+        const PropertyPoolObject* _objects = nullptr;
+        uint32_t _objectCount = 0;
+        const PropertyNode* _nodes = nullptr;
+        uint32_t _nodeCount = 0;
+        const PropertyPoolString* _strings = nullptr;
+        uint32_t _stringCount = 0;
+        const char* _stringData = nullptr;
+        uint64_t _stringDataSize = 0;
+        const uint8_t* _data = nullptr;
+        uint64_t _dataSize = 0;
+
+        const PropertyPoolString& _stringEntry(uint32_t id) const;
+    };
+
+    // Builds a pool from decoded objects. Strings are deduplicated, opaque values are copied into the data section,
+    // so the pool doesn't depend on the save body. Not thread safe, decode in parallel and add sequentially.
+    class PropertyPool {
+    public:
+        PropertyPool();
+
+        // returns the object's index in the pool
+        uint32_t add(const DecodedObject& object);
+        static PropertyPool build(const std::vector<DecodedObject>& objects);
+
+        // valid until the next add()
+        PropertyPoolView view() const;
+
+        size_t memoryUsage() const;
+
+    private:
+        std::vector<PropertyPoolObject> _objects;
+        std::vector<PropertyNode> _nodes;
+        std::vector<PropertyPoolString> _strings;
+        std::vector<char> _stringData;
+        std::vector<uint8_t> _data;
+        std::unique_ptr<StringTable> _table; // ids of the table are the pool's string ids
+
+        uint32_t _string(const StringView& str);
+        PropertyRef _bytes(const ByteView& bytes);
+        PropertyNode _node(const Property& property);
+    };
+
+}
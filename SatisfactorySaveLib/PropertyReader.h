@@ -1,8 +1,11 @@
 #pragma once
 
+#include "Endian.h"
 #include "Properties.h"
 
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 namespace factorygame {
 
@@ -16,28 +19,36 @@ namespace factorygame {
         T readBasicType() {
             T value;
             _stream.read((char*)&value, sizeof(value));
-            return value;
+            return littleEndian(value);
+        }
+
+        // Reads count consecutive scalars with a single stream read, check gcount() for short reads
+        template<typename T>
+        void readBasicTypes(T* values, int64_t count) {
+            _stream.read((char*)values, count * sizeof(T));
+            littleEndianInPlace<T>(values, count);
         }
 
         template<>
         String readBasicType() {
             String value;
-            int32_t sizeTmp = 0;
-            _stream.read((char*)&sizeTmp, sizeof(sizeTmp));
-            const bool notUtf8 = sizeTmp < 0;
+            const int32_t sizeTmp = readBasicType<int32_t>();
+            value.utf16 = sizeTmp < 0;
             const int32_t size = std::abs(sizeTmp);
             value.size = size;
             if (size > MAX_STRING_LEN) {
                 throw std::runtime_error("String too large");
             }
-            if (notUtf8) {
-                throw std::runtime_error("Only UTF8 is supported");
-                //return std::string();
+            if (value.utf16) {
+                std::vector<uint8_t> units(2 * static_cast<size_t>(size));
+                _stream.read((char*)units.data(), units.size());
+                appendUtf16AsUtf8(units.data(), utf16Strnlen(units.data(), size), value.str);
+                return value;
             }
             value.str.resize(size, '\0');
             if (size)
                 _stream.read((char*)&value.str.at(0), size);
-            value.str = std::string(value.str.c_str());
+            value.str.resize(strlen(value.str.c_str()));
             return value;
         }
 
@@ -54,18 +65,38 @@ namespace factorygame {
 
         template<typename T>
         void writeBasicType(const T& value) {
-            _stream.write((char*)&value, sizeof(value));
+            const T littleEndianValue = littleEndian(value);
+            _stream.write((char*)&littleEndianValue, sizeof(littleEndianValue));
+        }
+
+        template<typename T>
+        void writeBasicTypes(const T* values, int64_t count) {
+            if constexpr (hostIsBigEndian && sizeof(T) > 1) {
+                std::vector<T> swapped(values, values + count);
+                littleEndianInPlace<T>(swapped.data(), count);
+                _stream.write((const char*)swapped.data(), count * sizeof(T));
+            } else {
+                _stream.write((const char*)values, count * sizeof(T));
+            }
         }
 
         template<>
         void writeBasicType(const String& str) {
+            if (str.utf16) {
+                const int64_t units = utf16Length(str.str) + 1;
+                const int32_t size = static_cast<int32_t>(-units);
+                std::vector<uint8_t> data(2 * units, 0);
+                writeUtf8AsUtf16(str.str, data.data());
+                writeBasicType(size);
+                _stream.write((const char*)data.data(), data.size());
+                return;
+            }
             if (str.str.empty()) {
-                int32_t nullsize{0};
-                _stream.write((const char*)&nullsize, sizeof(int32_t));
+                writeBasicType(int32_t{ 0 });
                 return;
             }
-            int32_t size = static_cast<int32_t>(str.str.size()+1);
-            _stream.write((const char*)&size, sizeof(int32_t));
+            const int32_t size = static_cast<int32_t>(str.str.size()+1);
+            writeBasicType(size);
             _stream.write(str.str.data(), str.str.size());
             _stream.write("\0", 1);
         }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Properties.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace factorygame {
+
+    // Handle to a string stored once in a StringTable. Handles of one table are equal exactly when their strings are,
+    // so comparing, hashing and grouping them are integer operations. The table must outlive its handles.
+    class InternedString {
+    public:
+        struct Entry {
+            String value;
+            uint32_t id;
+        };
+
+        InternedString() = default; // the empty string, id 0
+        explicit InternedString(const Entry* entry) : _entry(entry) {}
+
+        const String& value() const { return _entry ? _entry->value : _empty(); }
+        const ArenaString& str() const { return value().str; }
+        uint32_t id() const { return _entry ? _entry->id : 0; }
+        bool empty() const { return _entry == nullptr; }
+
+        int64_t serializedSize() const { return value().serializedSize(); }
+
+        bool operator==(const InternedString& other) const { return _entry == other._entry; }
+        bool operator!=(const InternedString& other) const { return _entry != other._entry; }
+
+    private:
+        const Entry* _entry = nullptr;
+
+        static const String& _empty() {
+            static const String empty{ 0 };
+            return empty;
+        }
+    };
+
+    // Deduplicating store for the strings that repeat across the objects of a save (type paths, level names...).
+    // Not thread safe, the body parsers intern from a single thread.
+    class StringTable {
+    public:
+        StringTable() = default;
+        StringTable(const StringTable&) = delete;
+        StringTable& operator=(const StringTable&) = delete;
+
+        // size: the serialized length field, kept for the first occurrence of the string.
+        // Strings stored as UTF-16 (chars holds their UTF-8) are kept apart, so they are written back as such.
+        InternedString intern(std::string_view chars, int32_t size, bool utf16 = false) {
+            if (chars.empty() && !utf16) {
+                return {};
+            }
+            auto& index = _index[utf16];
+            auto it = index.find(chars);
+            if (it != index.end()) {
+                return InternedString(it->second);
+            }
+            auto& entry = _entries.emplace_back(InternedString::Entry{ { size, ArenaString(chars.data(), chars.size()), utf16 }, static_cast<uint32_t>(_entries.size() + 1) });
+            // the key views the entry's own characters, entries never move
+            index.emplace(std::string_view(entry.value.str.data(), entry.value.str.size()), &entry);
+            return InternedString(&entry);
+        }
+
+        InternedString intern(const String& str) {
+            return intern(std::string_view(str.str.data(), str.str.size()), str.size, str.utf16);
+        }
+
+        InternedString get(uint32_t id) const {
+            if (id == 0) {
+                return {};
+            }
+            if (id > _entries.size()) {
+                throw std::out_of_range("Unknown interned string id");
+            }
+            return InternedString(&_entries[id - 1]);
+        }
+
+        // number of distinct non-empty strings
+        size_t size() const { return _entries.size(); }
+
+    private:
+        std::deque<InternedString::Entry> _entries;
+        std::unordered_map<std::string_view, const InternedString::Entry*> _index[2]; // UTF-8, UTF-16
+    };
+
+}
+
+namespace std {
+
+    template<>
+    struct hash<factorygame::InternedString> {
+        size_t operator()(const factorygame::InternedString& str) const noexcept {
+            return hash<uint32_t>()(str.id());
+        }
+    };
+
+}
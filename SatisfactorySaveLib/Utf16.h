@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Arena.h"
+#include "Endian.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace factorygame {
+
+    // UTF-16 strings of a save (negative length field) are held as UTF-8. Unpaired surrogates are encoded like
+    // any other code point (WTF-8), so converting back reproduces the original code units exactly.
+
+    // number of little-endian code units before the first zero unit
+    inline int64_t utf16Strnlen(const uint8_t* units, int64_t maxCount) {
+        int64_t count = 0;
+        while (count < maxCount && (units[2 * count] | units[2 * count + 1])) {
+            ++count;
+        }
+        return count;
+    }
+
+    inline void _appendUtf8(uint32_t codePoint, ArenaString& out) {
+        if (codePoint < 0x80) {
+            out.push_back(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else if (codePoint < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    // Bytes that are not valid UTF-8 are taken as code points of their own (as Latin-1)
+    inline uint32_t _decodeUtf8(const uint8_t*& pos, const uint8_t* end) {
+        const uint8_t lead = *pos++;
+        uint32_t codePoint;
+        int extra;
+        if (lead < 0x80) {
+            return lead;
+        } else if ((lead & 0xE0) == 0xC0) {
+            codePoint = lead & 0x1F;
+            extra = 1;
+        } else if ((lead & 0xF0) == 0xE0) {
+            codePoint = lead & 0x0F;
+            extra = 2;
+        } else if ((lead & 0xF8) == 0xF0) {
+            codePoint = lead & 0x07;
+            extra = 3;
+        } else {
+            return lead;
+        }
+        if (end - pos < extra) {
+            return lead;
+        }
+        for (int i = 0; i < extra; ++i) {
+            if ((pos[i] & 0xC0) != 0x80) {
+                return lead;
+            }
+        }
+        for (int i = 0; i < extra; ++i) {
+            codePoint = (codePoint << 6) | (*pos++ & 0x3F);
+        }
+        return codePoint;
+    }
+
+    // Appends count little-endian code units as UTF-8. Runs of ASCII are found 4 units per 64-bit test
+    // and narrowed in a plain loop the compiler vectorizes.
+    inline void appendUtf16AsUtf8(const uint8_t* units, int64_t count, ArenaString& out) {
+        constexpr uint64_t nonAsciiMask = hostIsBigEndian ? 0x80FF80FF80FF80FFull : 0xFF80FF80FF80FF80ull;
+        out.reserve(out.size() + count);
+        int64_t ix = 0;
+        while (ix < count) {
+            int64_t run = ix;
+            for (uint64_t word; run + 4 <= count; run += 4) {
+                memcpy(&word, units + 2 * run, sizeof(word));
+                if (word & nonAsciiMask) {
+                    break;
+                }
+            }
+            while (run < count && units[2 * run] < 0x80 && units[2 * run + 1] == 0) {
+                ++run;
+            }
+            if (run > ix) {
+                const size_t start = out.size();
+                out.resize(start + (run - ix));
+                char* dst = &out[start];
+                for (int64_t unitIx = ix; unitIx < run; ++unitIx) {
+                    dst[unitIx - ix] = static_cast<char>(units[2 * unitIx]);
+                }
+                ix = run;
+                if (ix == count) {
+                    break;
+                }
+            }
+
+            uint32_t codePoint = units[2 * ix] | (units[2 * ix + 1] << 8);
+            ++ix;
+            if (codePoint >= 0xD800 && codePoint < 0xDC00 && ix < count) {
+                const uint32_t low = units[2 * ix] | (units[2 * ix + 1] << 8);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    ++ix;
+                }
+            }
+            _appendUtf8(codePoint, out);
+        }
+    }
+
+    // number of code units writeUtf8AsUtf16 produces
+    inline int64_t utf16Length(std::string_view utf8) {
+        const uint8_t* pos = reinterpret_cast<const uint8_t*>(utf8.data());
+        const uint8_t* end = pos + utf8.size();
+        int64_t count = 0;
+        while (pos < end) {
+            if (*pos < 0x80) {
+                ++pos;
+                ++count;
+                continue;
+            }
+            count += _decodeUtf8(pos, end) >= 0x10000 ? 2 : 1;
+        }
+        return count;
+    }
+
+    // Writes utf16Length(utf8) little-endian code units, without terminator
+    inline void writeUtf8AsUtf16(std::string_view utf8, uint8_t* out) {
+        const uint8_t* pos = reinterpret_cast<const uint8_t*>(utf8.data());
+        const uint8_t* end = pos + utf8.size();
+        while (pos < end) {
+            if (*pos < 0x80) {
+                out[0] = *pos++;
+                out[1] = 0;
+                out += 2;
+                continue;
+            }
+            uint32_t codePoint = _decodeUtf8(pos, end);
+            if (codePoint >= 0x10000) {
+                codePoint -= 0x10000;
+                const uint32_t high = 0xD800 + (codePoint >> 10);
+                out[0] = static_cast<uint8_t>(high);
+                out[1] = static_cast<uint8_t>(high >> 8);
+                out += 2;
+                codePoint = 0xDC00 + (codePoint & 0x3FF);
+            }
+            out[0] = static_cast<uint8_t>(codePoint);
+            out[1] = static_cast<uint8_t>(codePoint >> 8);
+            out += 2;
+        }
+    }
+
+}
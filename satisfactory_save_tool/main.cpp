@@ -2,12 +2,14 @@
 
 #include "..\SatisfactorySaveLib\FactoryGameSave.h"
 #include "..\SatisfactorySaveLib\Compressor.h"
+#include "..\SatisfactorySaveLib\PropertyDecoder.h"
 
 #include <iostream>
 #include <numeric>
 #include <iomanip>
+#include <chrono>
 
-std::vector < std::vector<uint8_t>> compressDataIntoChunks(const std::vector<uint8_t>& data) {
+std::vector < std::vector<uint8_t>> compressDataIntoChunks(const factorygame::ByteBuffer& data) {
     
     std::vector < std::vector<uint8_t>> chunks;
     int64_t rem = data.size();
@@ -28,27 +30,17 @@ void testSaveFile(std::string filename) {
     std::cout << loader.header().toString() << std::endl;
     auto& chunks = loader.chunks();
     std::cout << "nchunk: " << chunks.size() << std::endl;
-    std::ifstream ifs;
-    ifs.open(filename, std::ios::binary);
-    std::ofstream ofs;
-    std::string uncompressedFilename = "uncompressed_body.dat";
-    ofs.open(uncompressedFilename, std::ios::binary);
-    auto uncompressedData = factorygame::SaveFileLoader::decompressChunks(loader, ifs);
-    ofs.write((const char*)uncompressedData.data(), uncompressedData.size());
-    ofs.close();
-    std::ifstream uncompressedInputStream;
-    uncompressedInputStream.open(uncompressedFilename, std::ios::binary);
-
-    auto saveFileBody = factorygame::SaveFileBody::read(uncompressedInputStream);
-
-    std::stringstream writeBackTestSS;
-    saveFileBody.write(writeBackTestSS);
-    auto writeBackTestStr = writeBackTestSS.str();
+    factorygame::MappedFile mappedFile(filename);
+    auto uncompressedData = factorygame::SaveFileLoader::decompressChunks(loader, mappedFile, 0);
+
+    auto saveFileBody = factorygame::SaveFileBody::readParallel(uncompressedData, 0, std::make_shared<factorygame::Arena>());
+
+    auto writeBackTest = saveFileBody.serialize(0);
     
     std::cout << "uncompressed body size: " << uncompressedData.size() << std::endl;
-    std::cout << "writeback body size: " << writeBackTestStr.size() << std::endl;
+    std::cout << "writeback body size: " << writeBackTest.size() << std::endl;
     std::ofstream uncompWriteBackFile("uncomp_writeback.txt", std::ios::binary);
-    uncompWriteBackFile.write(writeBackTestStr.data(), writeBackTestStr.size());
+    uncompWriteBackFile.write((const char*)writeBackTest.data(), writeBackTest.size());
     uncompWriteBackFile.flush();
 
     /*
@@ -64,10 +56,18 @@ void testSaveFile(std::string filename) {
         std::cout << std::hex << std::setfill('0') << std::setw(2) << (int)firstActor.raw[i] << " ";
     } std::cout << std::endl;
     */
-    
+
+    if (!saveFileBody.objects.empty()) {
+        auto firstObject = factorygame::PropertyDecoder::decode(saveFileBody.objects[0]);
+        std::cout << "first object properties: " << firstObject.properties.size() << std::endl;
+        for (auto& property : firstObject.properties) {
+            std::cout << "  " << property.name.str << " (" << factorygame::PropertyDecoder::typeName(property.type) << ")" << std::endl;
+        }
+    }
+
 
     std::ofstream saveFileWriteBack("SaveFileWriteBack.sav", std::ios::binary);
-    factorygame::SaveFileWriter::save(saveFileWriteBack, loader.header(), saveFileBody);
+    factorygame::SaveFileWriter::save(saveFileWriteBack, loader.header(), saveFileBody, 0);
 
     /*
     std::ofstream log("log_objects.txt", std::ios::binary);
@@ -89,6 +89,51 @@ void testSaveFile(std::string filename) {
     std::cout << "recompressed size sum: " << sumsumsum << std::endl;
 }
 
+void benchmarkCompressionBackends(std::string filename) {
+    factorygame::SaveFileLoader loader(filename);
+    factorygame::MappedFile mappedFile(filename);
+    auto& chunks = loader.chunks();
+    int64_t uncompressedSizeSum = 0;
+    for (auto& chunk : chunks) {
+        uncompressedSizeSum += chunk.uncompressedSize;
+    }
+    factorygame::ByteBuffer body;
+    body.resize(uncompressedSizeSum);
+
+    auto mbPerSec = [](int64_t bytes, std::chrono::steady_clock::duration duration) {
+        return bytes / 1e6 / std::max(1e-9, std::chrono::duration<double>(duration).count());
+    };
+
+    for (auto backend : { CompressionBackendType::Zlib, CompressionBackendType::Libdeflate }) {
+        std::cout << Compressor::backendName(backend) << ": ";
+        if (!Compressor::isAvailable(backend)) {
+            std::cout << "skipped" << std::endl;
+            continue;
+        }
+        Compressor compressor(backend);
+
+        auto start = std::chrono::steady_clock::now();
+        int64_t offset = 0;
+        for (auto& chunk : chunks) {
+            compressor.decompressBlock(mappedFile.data() + chunk.pos, chunk.compressedSize, body.data() + offset, chunk.uncompressedSize);
+            offset += chunk.uncompressedSize;
+        }
+        auto inflateTime = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        int64_t compressedSizeSum = 0;
+        for (int64_t pos = 0; pos < uncompressedSizeSum; pos += factorygame::SaveFileWriter::chunkSize) {
+            auto size = std::min(factorygame::SaveFileWriter::chunkSize, uncompressedSizeSum - pos);
+            compressedSizeSum += compressor.compressBlock(body.data() + pos, size).size();
+        }
+        auto deflateTime = std::chrono::steady_clock::now() - start;
+
+        std::cout << "inflate " << mbPerSec(uncompressedSizeSum, inflateTime) << " MB/s, "
+            << "deflate " << mbPerSec(uncompressedSizeSum, deflateTime) << " MB/s, "
+            << "compressed size " << compressedSizeSum << std::endl;
+    }
+}
+
 void testCompressor() {
     auto vectorFromString = [](const std::string& str) {
         std::vector<uint8_t> vec;
@@ -108,6 +153,33 @@ void testCompressor() {
     std::cout << "decompressed str: " << std::string((const char*)decompressedData.data()) << std::endl;
 }
 
+// An actor whose parent name is stored as UTF-16 has to read back with the right payload size and write back unchanged
+bool testUtf16ActorObject() {
+    factorygame::ActorObjectRaw actor;
+    actor.parentObjectRoot = { 17, factorygame::ArenaString("Persistent_Level") };
+    actor.parentObjectName = { 5, factorygame::ArenaString("K\xC3\xB6ln"), true };
+    actor.componentCount = 0;
+    for (uint8_t value : { 1, 2, 3, 4, 5, 6, 7, 8 }) {
+        actor.raw.push_back(value);
+    }
+    actor.size = static_cast<factorygame::Int>(actor.serializedSize() - sizeof(factorygame::Int));
+
+    factorygame::ByteBuffer written(actor.serializedSize());
+    factorygame::BodyWriter writer(written.data(), written.size());
+    actor.write(writer);
+
+    factorygame::BodyReader reader(written);
+    auto readBack = factorygame::ActorObjectRaw::read(reader);
+    factorygame::ByteBuffer rewritten(readBack.serializedSize());
+    factorygame::BodyWriter rewriter(rewritten.data(), rewritten.size());
+    readBack.write(rewriter);
+
+    const bool ok = reader.remaining() == 0 && readBack.raw.size() == actor.raw.size() && readBack.parentObjectName.utf16
+        && readBack.parentObjectName.str == actor.parentObjectName.str && rewritten == written;
+    std::cout << "utf16 actor object round trip: " << (ok ? "ok" : "MISMATCH") << std::endl;
+    return ok;
+}
+
 int main(int argc, const char* argv[])
 {
     try {
@@ -115,7 +187,13 @@ int main(int argc, const char* argv[])
         if (argc > 1) {
             filename = std::string(argv[1]);
         }
-        testSaveFile(filename);
+        if (argc > 2 && std::string(argv[2]) == "--bench-compression") {
+            benchmarkCompressionBackends(filename);
+        } else if (argc > 2 && std::string(argv[2]) == "--self-test") {
+            testUtf16ActorObject();
+        } else {
+            testSaveFile(filename);
+        }
         //testCompressor();
     } catch (const std::exception& e) {
         std::cout << "exception: " << e.what() << std::endl;